@@ -60,6 +60,10 @@ pub fn build(b: *std.Build) void {
         .optimize = optimize,
     });
 
+    exe_unit_tests.addIncludePath(b.path("./src/libs"));
+    exe_unit_tests.addObjectFile(b.path("./src/libs/tb.a"));
+    exe_unit_tests.linkLibC();
+
     const run_exe_unit_tests = b.addRunArtifact(exe_unit_tests);
 
     // Similar to creating the run step earlier, this exposes a `test` step to
@@ -0,0 +1,119 @@
+const std = @import("std");
+
+const CodeGen = @import("CodeGen.zig");
+const March = @import("March.zig");
+
+const tb = @import("libs/tb/tb.zig");
+
+// Listing and size table of the asm subcommand. The numbers are read back from
+// the listing TB emits, so they describe the code that actually runs
+pub const Stats = struct {
+    name: []const u8,
+    bytes: u64 = 0,
+    instructions: u32 = 0,
+    // Stores of a register into a stack slot
+    spills: u32 = 0,
+    // What the prologue takes off rsp
+    frame: u64 = 0,
+};
+
+const Report = struct {
+    march: []const u8,
+    functions: []const Stats,
+    bytes: u64,
+};
+
+pub fn toString(alloc: std.mem.Allocator, jobs: []const CodeGen.Job, features: tb.FeatureSet, json: bool) std.mem.Allocator.Error!std.ArrayList(u8) {
+    var cont = std.ArrayList(u8).init(alloc);
+    const march = try std.fmt.allocPrint(alloc, "{}", .{March.fmt(features)});
+    defer alloc.free(march);
+    if (!json) try cont.writer().print("; -march={s}\n", .{march});
+
+    var text = std.ArrayList(u8).init(alloc);
+    defer text.deinit();
+
+    const stats = try alloc.alloc(Stats, jobs.len);
+    defer alloc.free(stats);
+
+    var total: u64 = 0;
+    for (jobs, stats) |job, *s| {
+        text.clearRetainingCapacity();
+        var chunk = job.out.getAsm();
+        while (chunk) |c| : (chunk = c.next) {
+            try text.appendSlice(c.data()[0..c.length]);
+        }
+
+        s.* = scan(text.items);
+        s.name = job.name;
+        s.bytes = job.out.getCode().len;
+        total += s.bytes;
+
+        if (!json) try cont.appendSlice(text.items);
+    }
+
+    const w = cont.writer();
+    if (json) {
+        try std.json.stringify(Report{ .march = march, .functions = stats, .bytes = total }, .{ .whitespace = .indent_2 }, w);
+        try cont.append('\n');
+        return cont;
+    }
+
+    try w.print("\n{s:<24} {s:>8} {s:>8} {s:>8} {s:>8}\n", .{ "function", "bytes", "insts", "spills", "frame" });
+    for (stats) |s| {
+        try w.print("{s:<24} {:>8} {:>8} {:>8} {:>8}\n", .{ s.name, s.bytes, s.instructions, s.spills, s.frame });
+    }
+    try w.print("{s:<24} {:>8}\n", .{ "total", total });
+
+    return cont;
+}
+
+// Labels end in ':' and comments start with ';', every other line is one instruction
+fn scan(text: []const u8) Stats {
+    var s = Stats{ .name = "" };
+
+    var lines = std.mem.tokenizeScalar(u8, text, '\n');
+    while (lines.next()) |raw| {
+        const line = std.mem.trim(u8, raw, " \t\r");
+        if (line.len == 0 or line[0] == ';' or line[line.len - 1] == ':') continue;
+        s.instructions += 1;
+
+        // Only the destination, the part before the first operand separator
+        const dst = line[0 .. std.mem.indexOfScalar(u8, line, ',') orelse line.len];
+        if (std.mem.indexOf(u8, dst, "mov") != null and
+            (std.mem.indexOf(u8, dst, "[rsp") != null or std.mem.indexOf(u8, dst, "[rbp") != null))
+            s.spills += 1;
+
+        if (s.frame == 0) {
+            if (std.mem.indexOf(u8, line, "sub rsp,")) |i| s.frame = immediate(line[i + "sub rsp,".len ..]);
+        }
+    }
+
+    return s;
+}
+
+fn immediate(operand: []const u8) u64 {
+    const v = std.mem.trim(u8, operand, " \t");
+    if (std.mem.startsWith(u8, v, "0x")) return std.fmt.parseInt(u64, v[2..], 16) catch 0;
+    return std.fmt.parseInt(u64, v, 10) catch 0;
+}
+
+test "scan" {
+    const listing =
+        \\main:
+        \\.bb0:
+        \\  push rbp
+        \\  mov rbp, rsp
+        \\  sub rsp, 0x20
+        \\  ; spill
+        \\  mov qword [rsp + 8], rax
+        \\  mov rcx, qword [rsp + 8]
+        \\  add rax, rcx
+        \\  ret
+        \\
+    ;
+
+    const s = scan(listing);
+    try std.testing.expectEqual(@as(u32, 7), s.instructions);
+    try std.testing.expectEqual(@as(u32, 1), s.spills);
+    try std.testing.expectEqual(@as(u64, 32), s.frame);
+}
@@ -0,0 +1,145 @@
+const std = @import("std");
+const Logger = @import("Logger.zig");
+
+const gen = @import("General.zig");
+const Arguments = @import("ParseArgs.zig").Arguments;
+const March = @import("March.zig");
+
+const Lexer = @import("./Lexer/Lexer.zig");
+
+// Machine code of each function on disk, one file per function named after
+// the hash of its tokens, the compiler version and the flags that change codegen.
+// The language has no calls or globals yet, so the code has no relocations and
+// the bytes behind a small header are all there is to store
+pub const dirName = ".yot-cache";
+
+dir: std.fs.Dir,
+salt: u64,
+alloc: std.mem.Allocator,
+hits: u64 = 0,
+misses: u64 = 0,
+
+pub fn init(alloc: std.mem.Allocator, arguments: Arguments) ?@This() {
+    const dir = std.fs.cwd().makeOpenPath(dirName, .{}) catch |err| {
+        Logger.log.warn("Could not open cache directory {s} because {}, compiling everything", .{ dirName, err });
+        return null;
+    };
+
+    return @This(){
+        .dir = dir,
+        .salt = saltOf(arguments),
+        .alloc = alloc,
+    };
+}
+
+pub fn deinit(self: *@This()) void {
+    self.dir.close();
+}
+
+// Everything that can change the bytes of a function besides its source
+fn saltOf(arguments: Arguments) u64 {
+    var h = std.hash.Wyhash.init(0);
+    h.update(gen.version);
+    h.update(&.{ @intFromBool(arguments.run), arguments.optimize, @intFromEnum(arguments.overflow) });
+    h.update(std.mem.asBytes(&March.forArguments(arguments)));
+    return h.final();
+}
+
+// Tokens in [start, end) of the function, whitespace and comments do not invalidate it
+pub fn key(self: @This(), lexer: *const Lexer, start: u32, end: u32) u64 {
+    var h = std.hash.Wyhash.init(self.salt);
+    const tags = lexer.tokens.items(.tag);
+    for (start..end) |i| {
+        const text = lexer.str(@intCast(i));
+        h.update(&.{@intFromEnum(tags[i])});
+        h.update(std.mem.asBytes(&@as(u32, @intCast(text.len))));
+        h.update(text);
+    }
+
+    return h.final();
+}
+
+fn fileName(k: u64) [16]u8 {
+    var buf: [16]u8 = undefined;
+    _ = std.fmt.bufPrint(&buf, "{x:0>16}", .{k}) catch unreachable;
+    return buf;
+}
+
+// In front of every entry. A file that was cut short, mixed up by two writers
+// or written by another format does not match it and is a miss
+const Header = extern struct {
+    magic: [4]u8 = "yotc".*,
+    format: u32 = format,
+    len: u64,
+    hash: u64,
+};
+
+const format = 1;
+
+// The key seeds the hash, an entry renamed to another key does not check out either
+fn hashOf(k: u64, code: []const u8) u64 {
+    return std.hash.Wyhash.hash(k, code);
+}
+
+// Null on a miss, a broken or unreadable entry is a miss too
+pub fn load(self: *@This(), k: u64) ?[]const u8 {
+    const name = fileName(k);
+    const data = self.dir.readFileAlloc(self.alloc, &name, std.math.maxInt(u32)) catch {
+        self.misses += 1;
+        return null;
+    };
+
+    const code = check(k, data) orelse {
+        Logger.log.warn("Ignoring broken cache entry {s}", .{name});
+        self.alloc.free(data);
+        self.misses += 1;
+        return null;
+    };
+
+    self.hits += 1;
+    return code;
+}
+
+fn check(k: u64, data: []const u8) ?[]const u8 {
+    if (data.len < @sizeOf(Header)) return null;
+    const header = std.mem.bytesToValue(Header, data[0..@sizeOf(Header)]);
+    const code = data[@sizeOf(Header)..];
+
+    if (!std.mem.eql(u8, &header.magic, "yotc") or header.format != format) return null;
+    if (header.len != code.len or header.hash != hashOf(k, code)) return null;
+    return code;
+}
+
+// Every writer gets its own temporary file, renamed over the entry once it is complete
+pub fn store(self: *@This(), k: u64, code: []const u8) void {
+    const name = fileName(k);
+    write(self.dir, &name, k, code) catch |err| {
+        Logger.log.warn("Could not write cache entry {s} because {}", .{ name, err });
+    };
+}
+
+fn write(dir: std.fs.Dir, name: []const u8, k: u64, code: []const u8) !void {
+    var af = try dir.atomicFile(name, .{});
+    defer af.deinit();
+
+    const header = Header{ .len = code.len, .hash = hashOf(k, code) };
+    try af.file.writeAll(std.mem.asBytes(&header));
+    try af.file.writeAll(code);
+    try af.finish();
+}
+
+test "check" {
+    const code = [_]u8{ 0x31, 0xc0, 0xc3 };
+    const header = Header{ .len = code.len, .hash = hashOf(7, &code) };
+
+    var entry: [@sizeOf(Header) + code.len]u8 = undefined;
+    @memcpy(entry[0..@sizeOf(Header)], std.mem.asBytes(&header));
+    @memcpy(entry[@sizeOf(Header)..], &code);
+
+    try std.testing.expectEqualSlices(u8, &code, check(7, &entry).?);
+    // Another key, a truncated file and a flipped byte are all misses
+    try std.testing.expect(check(8, &entry) == null);
+    try std.testing.expect(check(7, entry[0 .. entry.len - 1]) == null);
+    entry[entry.len - 1] ^= 1;
+    try std.testing.expect(check(7, &entry) == null);
+}
@@ -0,0 +1,105 @@
+const std = @import("std");
+
+const tb = @import("libs/tb/tb.zig");
+
+// Arithmetic for -safe. The wrapped result is computed as usual and tested
+// afterwards, the trap sits behind a branch marked as never taken so the hot
+// path only pays for the test and a fallthrough jump
+
+fn binop(g: tb.GraphBuilder, t: tb.NodeType, a: *tb.Node, b: *tb.Node) *tb.Node {
+    return g.binopInt(t, a, b, tb.ArithmeticBehavior.NONE);
+}
+
+fn negative(g: tb.GraphBuilder, v: *tb.Node) *tb.Node {
+    return g.cmp(tb.NodeType.CMP_SLT, v, g.uint(v.dt, 0));
+}
+
+// Building goes on in the path where nothing overflowed
+fn trapIf(g: tb.GraphBuilder, overflowed: *tb.Node) void {
+    var paths: [2]*tb.Node = undefined;
+    g.ifCold(overflowed, &paths);
+
+    _ = g.labelSet(paths[0]);
+    g.trap(0);
+    g.labelKill(paths[0]);
+
+    _ = g.labelSet(paths[1]);
+}
+
+pub fn add(g: tb.GraphBuilder, a: *tb.Node, b: *tb.Node, signed: bool) *tb.Node {
+    const r = binop(g, tb.NodeType.ADD, a, b);
+    // Signed: both operands have the sign the sum lost. Unsigned: the sum is below an operand
+    trapIf(g, if (signed)
+        negative(g, binop(g, tb.NodeType.AND, binop(g, tb.NodeType.XOR, r, a), binop(g, tb.NodeType.XOR, r, b)))
+    else
+        g.cmp(tb.NodeType.CMP_ULT, r, a));
+    return r;
+}
+
+pub fn sub(g: tb.GraphBuilder, a: *tb.Node, b: *tb.Node, signed: bool) *tb.Node {
+    const r = binop(g, tb.NodeType.SUB, a, b);
+    // Signed: the operands differ in sign and the result took the sign of b
+    trapIf(g, if (signed)
+        negative(g, binop(g, tb.NodeType.AND, binop(g, tb.NodeType.XOR, a, b), binop(g, tb.NodeType.XOR, a, r)))
+    else
+        g.cmp(tb.NodeType.CMP_ULT, a, b));
+    return r;
+}
+
+pub fn neg(g: tb.GraphBuilder, a: *tb.Node, signed: bool) *tb.Node {
+    const r = g.neg(a);
+    // minInt is its own negation, and only 0 has an unsigned one
+    trapIf(g, if (signed)
+        g.cmp(tb.NodeType.CMP_EQ, a, g.uint(a.dt, minInt(a.dt)))
+    else
+        g.cmp(tb.NodeType.CMP_NE, a, g.uint(a.dt, 0)));
+    return r;
+}
+
+pub fn mul(g: tb.GraphBuilder, a: *tb.Node, b: *tb.Node, signed: bool) *tb.Node {
+    const r = binop(g, tb.NodeType.MUL, a, b);
+
+    if (a.dt.x.type != .I64) {
+        // The exact product fits in 64 bits, it overflowed if narrowing changed it
+        const ext = if (signed) tb.NodeType.SIGN_EXT else tb.NodeType.ZERO_EXT;
+        const wide = binop(g, tb.NodeType.MUL, g.cast(tb.typeI64(), ext, a), g.cast(tb.typeI64(), ext, b));
+        trapIf(g, g.cmp(tb.NodeType.CMP_NE, wide, g.cast(tb.typeI64(), ext, r)));
+        return r;
+    }
+
+    // The high half has to be what extending the low half would give
+    const high = mulHigh(g, a, b, signed);
+    const expected = if (signed) binop(g, tb.NodeType.SAR, r, g.uint(r.dt, 63)) else g.uint(r.dt, 0);
+    trapIf(g, g.cmp(tb.NodeType.CMP_NE, high, expected));
+    return r;
+}
+
+// High 64 bits of the 128 bit product from four 32 bit partial products, the
+// signed one corrects the unsigned by the operands that were negative
+fn mulHigh(g: tb.GraphBuilder, a: *tb.Node, b: *tb.Node, signed: bool) *tb.Node {
+    const half = g.uint(a.dt, 0xffff_ffff);
+    const thirtyTwo = g.uint(a.dt, 32);
+    const a0 = binop(g, tb.NodeType.AND, a, half);
+    const a1 = binop(g, tb.NodeType.SHR, a, thirtyTwo);
+    const b0 = binop(g, tb.NodeType.AND, b, half);
+    const b1 = binop(g, tb.NodeType.SHR, b, thirtyTwo);
+
+    const t = binop(g, tb.NodeType.ADD, binop(g, tb.NodeType.MUL, a1, b0), binop(g, tb.NodeType.SHR, binop(g, tb.NodeType.MUL, a0, b0), thirtyTwo));
+    const middle = binop(g, tb.NodeType.ADD, binop(g, tb.NodeType.MUL, a0, b1), binop(g, tb.NodeType.AND, t, half));
+    var high = binop(g, tb.NodeType.ADD, binop(g, tb.NodeType.MUL, a1, b1), binop(g, tb.NodeType.SHR, t, thirtyTwo));
+    high = binop(g, tb.NodeType.ADD, high, binop(g, tb.NodeType.SHR, middle, thirtyTwo));
+    if (!signed) return high;
+
+    const sixtyThree = g.uint(a.dt, 63);
+    high = binop(g, tb.NodeType.SUB, high, binop(g, tb.NodeType.AND, binop(g, tb.NodeType.SAR, a, sixtyThree), b));
+    return binop(g, tb.NodeType.SUB, high, binop(g, tb.NodeType.AND, binop(g, tb.NodeType.SAR, b, sixtyThree), a));
+}
+
+fn minInt(dt: tb.DataType) u64 {
+    return switch (dt.x.type) {
+        .I8 => 0x80,
+        .I16 => 0x8000,
+        .I32 => 0x8000_0000,
+        else => 0x8000_0000_0000_0000,
+    };
+}
@@ -0,0 +1,132 @@
+const std = @import("std");
+const Logger = @import("Logger.zig");
+
+const tb = @import("libs/tb/tb.zig");
+
+// tb_codegen of every function of the module in parallel. Code arenas and
+// worklists are not thread safe, so every worker owns one of each and takes the
+// next function from a shared counter. Outputs land in the slot of their
+// function, whatever uses them walks the jobs in order, not in completion order
+pub const Job = struct {
+    name: []const u8,
+    f: tb.Function,
+    cacheKey: ?u64 = null,
+    out: tb.FunctionOutput = undefined,
+    ns: u64 = 0,
+};
+
+// Outlives a compile, serve clears the arena between requests
+pub const Worker = struct {
+    arena: tb.Arena = undefined,
+    ws: tb.Worklist = undefined,
+    thread: ?std.Thread = null,
+
+    pub fn createAll(alloc: std.mem.Allocator) std.mem.Allocator.Error![]Worker {
+        const workers = try alloc.alloc(Worker, @max(1, std.Thread.getCpuCount() catch 1));
+        for (workers) |*w| {
+            w.* = .{ .ws = tb.Worklist.alloc() };
+            tb.Arena.create(&w.arena, "Codegen worker");
+        }
+
+        return workers;
+    }
+
+    pub fn destroyAll(alloc: std.mem.Allocator, workers: []Worker) void {
+        for (workers) |*w| {
+            w.arena.destroy();
+            w.ws.free();
+        }
+        alloc.free(workers);
+    }
+};
+
+jobs: []Job,
+workers: []Worker,
+// Threads are spawned for the run without one
+pool: ?*std.Thread.Pool,
+// What -march allows, the same for every function
+features: tb.FeatureSet,
+// Keep the assembly listing of every function for the asm subcommand
+emitAsm: bool,
+next: std.atomic.Value(usize) = std.atomic.Value(usize).init(0),
+// Wall clock of the whole phase, the job times add up to what one thread would take
+wallNs: u64 = 0,
+
+// The arenas of the workers hold the machine code, so they are only cleared
+// once the module is exported or placed
+pub fn init(jobs: []Job, workers: []Worker, pool: ?*std.Thread.Pool, features: tb.FeatureSet, emitAsm: bool) @This() {
+    return @This(){
+        .jobs = jobs,
+        .workers = workers[0..@max(1, @min(workers.len, jobs.len))],
+        .pool = pool,
+        .features = features,
+        .emitAsm = emitAsm,
+    };
+}
+
+pub fn run(self: *@This()) void {
+    var timer = std.time.Timer.start() catch unreachable;
+
+    // The calling thread is the first worker. If a spawn fails the others
+    // just take its share from the counter
+    if (self.pool) |pool| {
+        var wg = std.Thread.WaitGroup{};
+        for (self.workers[1..]) |*w| {
+            wg.start();
+            pool.spawn(workGroup, .{ self, w, &wg }) catch wg.finish();
+        }
+        work(self, &self.workers[0]);
+        wg.wait();
+    } else {
+        for (self.workers[1..]) |*w| {
+            w.thread = std.Thread.spawn(.{}, work, .{ self, w }) catch null;
+        }
+        work(self, &self.workers[0]);
+
+        for (self.workers[1..]) |*w| {
+            if (w.thread) |t| t.join();
+            w.thread = null;
+        }
+    }
+
+    self.wallNs = timer.read();
+}
+
+fn workGroup(self: *@This(), w: *Worker, wg: *std.Thread.WaitGroup) void {
+    defer wg.finish();
+    work(self, w);
+}
+
+fn work(self: *@This(), w: *Worker) void {
+    while (true) {
+        const i = self.next.fetchAdd(1, .monotonic);
+        if (i >= self.jobs.len) return;
+
+        const job = &self.jobs[i];
+        var timer = std.time.Timer.start() catch unreachable;
+        job.out = job.f.codeGen(w.ws, &w.arena, &self.features, self.emitAsm);
+        job.ns = timer.read();
+    }
+}
+
+// Bytes of machine code generated for f
+pub fn codeSize(self: @This(), f: tb.Function) usize {
+    for (self.jobs) |j| {
+        if (j.f.f == f.f) return j.out.getCode().len;
+    }
+
+    return 0;
+}
+
+pub fn report(self: @This()) void {
+    var serial: u64 = 0;
+    for (self.jobs) |j| serial += j.ns;
+
+    Logger.log.info("Codegen of {} functions on {} threads in {}, {} of work ({d:.2}x)", .{
+        self.jobs.len,
+        self.workers.len,
+        std.fmt.fmtDuration(self.wallNs),
+        std.fmt.fmtDuration(serial),
+        @as(f64, @floatFromInt(serial)) / @as(f64, @floatFromInt(@max(self.wallNs, 1))),
+    });
+}
@@ -0,0 +1,219 @@
+const std = @import("std");
+
+const Parser = @import("./Parser/Parser.zig");
+const Program = Parser.Program;
+const Primitive = Parser.Primitive;
+const Expression = Parser.Expression;
+const Ast = Parser.Ast;
+const Overflow = @import("ParseArgs.zig").Overflow;
+
+// Evaluates constant subtrees with the same fixed width semantics the backend
+// uses for the type of the expression and replaces them with a single constant.
+// Values of immutable lets are propagated to the expressions after them.
+// Under -safe whatever overflows is left for the runtime check to trap on
+pub const Stats = struct {
+    // Operators evaluated at compile time
+    folded: u64 = 0,
+    // Uses of immutable variables replaced by their value
+    propagated: u64 = 0,
+    // Nodes that codegen no longer visits
+    removed: u64 = 0,
+};
+
+// The type of the let is kept with its value, a read from a wider expression
+// extends it the way the backend does
+const Value = struct {
+    v: u64,
+    ty: Primitive,
+};
+
+const Values = std.AutoHashMap(u32, Value);
+
+pub fn constantFold(alloc: std.mem.Allocator, p: *Program, overflow: Overflow, stats: *Stats) std.mem.Allocator.Error!void {
+    var values = Values.init(alloc);
+    defer values.deinit();
+
+    for (p.funcs.items) |func| {
+        values.clearRetainingCapacity();
+
+        for (func.body.items) |stmt| {
+            switch (stmt) {
+                .ret => |ret| _ = fold(&p.ast, ret.expr, func.returnType, &values, overflow, stats),
+                .let => |let| {
+                    const v = fold(&p.ast, let.expr, let.t, &values, overflow, stats);
+                    // A later let with the same name shadows the old value
+                    if (v != null and !let.mut)
+                        try values.put(let.id, .{ .v = v.?, .ty = let.t })
+                    else
+                        _ = values.remove(let.id);
+                },
+                .func => continue,
+            }
+        }
+    }
+}
+
+fn fold(ast: *Ast, e: Expression, ty: Primitive, values: *const Values, overflow: Overflow, stats: *Stats) ?u64 {
+    if (ty.type != .signed and ty.type != .unsigned) return null;
+
+    const node = ast.get(e);
+    const result: u64 = switch (node.tag) {
+        .constant => return ast.value(e),
+        // Decoded into constants by the type check
+        .leaf => unreachable,
+        .variable => {
+            const v = values.get(node.lhs) orelse return null;
+            stats.propagated += 1;
+            const r = resize(v.v, v.ty, ty);
+            ast.setConstant(e, r);
+            return r;
+        },
+        .paren => {
+            const v = fold(ast, ast.lhs(e), ty, values, overflow, stats) orelse return null;
+            stats.removed += 1;
+            ast.setConstant(e, v);
+            return v;
+        },
+        .una => {
+            // -128 is the literal 128 negated, in range of a signed type even though
+            // 128 alone is not. Unsigned literals get no such pass, -5 traps like any negation.
+            // Asked before the operand is folded, afterwards any constant looks like a literal
+            const literal = isLiteral(ast, ast.lhs(e)) and ty.type == .signed;
+            const v = fold(ast, ast.lhs(e), ty, values, overflow, stats) orelse return null;
+            if (overflow == .safe and !literal and negationOverflows(v, ty)) return null;
+            stats.folded += 1;
+            stats.removed += 1;
+            ast.setConstant(e, truncate(0 -% v, ty));
+            return truncate(0 -% v, ty);
+        },
+        .bin => blk: {
+            // Both sides are always visited so a constant half still folds
+            const left = fold(ast, ast.lhs(e), ty, values, overflow, stats);
+            const right = fold(ast, ast.rhs(e), ty, values, overflow, stats);
+            if (left == null or right == null) return null;
+
+            const op = ast.str(e)[0];
+            if (overflow == .safe and overflows(op, left.?, right.?, ty)) return null;
+            break :blk binary(op, left.?, right.?, ty) orelse return null;
+        },
+    };
+
+    stats.folded += 1;
+    stats.removed += 2;
+    ast.setConstant(e, result);
+    return result;
+}
+
+// The type check turned every literal into a constant and the fold has not
+// reached below e yet, so a constant under the parens came from the source
+fn isLiteral(ast: *const Ast, e: Expression) bool {
+    var inner = e;
+    while (ast.tag(inner) == .paren) inner = ast.lhs(inner);
+    return ast.tag(inner) == .constant;
+}
+
+fn binary(op: u8, a: u64, b: u64, ty: Primitive) ?u64 {
+    const result = switch (op) {
+        '+' => a +% b,
+        '-' => a -% b,
+        '*' => a *% b,
+        '^' => power(a, b, ty),
+        '/', '%' => divide(op, a, b, ty) orelse return null,
+        else => return null,
+    };
+
+    return truncate(result, ty);
+}
+
+// The backend treats the exponent as unsigned, so only its bits matter
+fn power(base: u64, exp: u64, ty: Primitive) u64 {
+    var result: u64 = 1;
+    var b = base;
+    var n = exp;
+    while (n != 0) : (n >>= 1) {
+        if (n & 1 == 1) result = truncate(result *% b, ty);
+        b = truncate(b *% b, ty);
+    }
+
+    return result;
+}
+
+// UDIV/UMOD or SDIV/SMOD depending on the type, both truncate towards zero.
+// Whatever faults at runtime (x / 0, minInt / -1) is left to the backend so it still does
+fn divide(op: u8, a: u64, b: u64, ty: Primitive) ?u64 {
+    if (b == 0) return null;
+    if (ty.type == .unsigned) return if (op == '/') a / b else a % b;
+
+    const x = signExtend(a, ty);
+    const y = signExtend(b, ty);
+    if (y == -1 and x == signExtend(@as(u64, 1) << @intCast(ty.size - 1), ty)) return null;
+
+    return @bitCast(if (op == '/') @divTrunc(x, y) else @rem(x, y));
+}
+
+// Checked the way -safe code checks at runtime
+fn overflows(op: u8, a: u64, b: u64, ty: Primitive) bool {
+    if (op == '^') return powerOverflows(a, b, ty);
+    if (ty.type == .unsigned) {
+        const x: u128 = a;
+        const y: u128 = b;
+        return switch (op) {
+            '+' => x + y > truncate(std.math.maxInt(u64), ty),
+            '-' => a < b,
+            '*' => x * y > truncate(std.math.maxInt(u64), ty),
+            else => false,
+        };
+    }
+
+    const x: i128 = signExtend(a, ty);
+    const y: i128 = signExtend(b, ty);
+    const r = switch (op) {
+        '+' => x + y,
+        '-' => x - y,
+        '*' => x * y,
+        else => return false,
+    };
+    const limit = @as(i128, 1) << @intCast(ty.size - 1);
+    return r < -limit or r >= limit;
+}
+
+// Every product that reaches the result, the squaring after the last bit is never used
+fn powerOverflows(base: u64, exp: u64, ty: Primitive) bool {
+    var result: u64 = 1;
+    var b = base;
+    var n = exp;
+    while (n != 0) {
+        if (n & 1 == 1) {
+            if (overflows('*', result, b, ty)) return true;
+            result = truncate(result *% b, ty);
+        }
+        n >>= 1;
+        if (n == 0) break;
+        if (overflows('*', b, b, ty)) return true;
+        b = truncate(b *% b, ty);
+    }
+
+    return false;
+}
+
+fn negationOverflows(v: u64, ty: Primitive) bool {
+    if (ty.type == .unsigned) return v != 0;
+    return v == @as(u64, 1) << @intCast(ty.size - 1);
+}
+
+// tbHelper.resize on constants, narrower values are extended by the signedness of the variable
+fn resize(v: u64, from: Primitive, to: Primitive) u64 {
+    if (from.type == .signed and from.size < to.size) return truncate(@bitCast(signExtend(v, from)), to);
+    return truncate(v, to);
+}
+
+fn truncate(v: u64, ty: Primitive) u64 {
+    if (ty.size >= 64) return v;
+    return v & ((@as(u64, 1) << @intCast(ty.size)) - 1);
+}
+
+fn signExtend(v: u64, ty: Primitive) i64 {
+    if (ty.size >= 64) return @bitCast(v);
+    const shift: u6 = @intCast(64 - @as(u32, ty.size));
+    return @as(i64, @bitCast(v << shift)) >> shift;
+}
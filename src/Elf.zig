@@ -0,0 +1,336 @@
+const std = @import("std");
+const elf = std.elf;
+const Logger = @import("Logger.zig");
+
+// Static linker for the one relocatable object TB exports. Allocated sections
+// are laid out in a code, a read only and a writable segment, undefined symbols
+// resolve by name against the defined ones and the relocations are applied in
+// memory, so the executable is written in one go without ld or a temporary object
+const base: u64 = 0x400000;
+const page: u64 = 0x1000;
+
+pub const Error = error{
+    InvalidObject,
+    UndefinedSymbol,
+    UnsupportedObject,
+    RelocationOverflow,
+    NoEntryPoint,
+} || std.mem.Allocator.Error || std.fs.File.OpenError || std.fs.File.WriteError;
+
+// x86-64 relocation types TB emits
+const R_64 = 1;
+const R_PC32 = 2;
+const R_PLT32 = 4;
+const R_GOTPCREL = 9;
+const R_32 = 10;
+const R_32S = 11;
+const R_PC64 = 24;
+const R_GOTPCRELX = 41;
+const R_REX_GOTPCRELX = 42;
+
+const Segment = enum { code, rodata, data };
+
+const Section = struct {
+    header: elf.Elf64_Shdr,
+    // Null for whatever is not loaded: symbols, relocations, debug info
+    segment: ?Segment = null,
+    offset: u64 = 0,
+    addr: u64 = 0,
+};
+
+alloc: std.mem.Allocator,
+object: []const u8,
+sections: []Section,
+symbols: []elf.Elf64_Sym,
+strtab: []const u8,
+// Defined symbols by name, globals win over locals
+names: std.StringHashMap(u64),
+// Symbols loaded through the GOT, each owns a slot in order
+got: std.AutoArrayHashMap(u32, void),
+gotOffset: u64 = 0,
+phdrs: std.BoundedArray(elf.Elf64_Phdr, 3) = .{},
+image: []u8 = &.{},
+
+// Returns the size of the executable written to path
+pub fn link(alloc: std.mem.Allocator, object: []const u8, path: []const u8) Error!usize {
+    var self = try init(alloc, object);
+    defer self.deinit();
+
+    try self.layout();
+    try self.define();
+    try self.relocate();
+
+    const entry = self.names.get("_start") orelse {
+        Logger.log.err("No _start to use as the entry point", .{});
+        return error.NoEntryPoint;
+    };
+    self.writeHeaders(entry);
+
+    const file = try std.fs.cwd().createFile(path, .{ .mode = 0o755 });
+    defer file.close();
+    try file.writeAll(self.image);
+
+    return self.image.len;
+}
+
+fn init(alloc: std.mem.Allocator, object: []const u8) Error!@This() {
+    const ehdr = try read(elf.Elf64_Ehdr, object, 0);
+    if (!std.mem.eql(u8, ehdr.e_ident[0..4], elf.MAGIC) or ehdr.e_ident[elf.EI_CLASS] != elf.ELFCLASS64 or
+        ehdr.e_type != .REL or ehdr.e_machine != .X86_64)
+        return error.InvalidObject;
+
+    var self = @This(){
+        .alloc = alloc,
+        .object = object,
+        .sections = try alloc.alloc(Section, ehdr.e_shnum),
+        .symbols = &.{},
+        .strtab = &.{},
+        .names = std.StringHashMap(u64).init(alloc),
+        .got = std.AutoArrayHashMap(u32, void).init(alloc),
+    };
+    errdefer self.deinit();
+
+    const sections = self.sections;
+    for (sections, 0..) |*s, i| {
+        s.* = .{ .header = try read(elf.Elf64_Shdr, object, ehdr.e_shoff + i * ehdr.e_shentsize) };
+    }
+
+    for (sections) |s| {
+        if (s.header.sh_type != elf.SHT_SYMTAB) continue;
+        if (s.header.sh_link >= sections.len) return error.InvalidObject;
+
+        self.strtab = try self.contents(sections[s.header.sh_link].header);
+        const bytes = try self.contents(s.header);
+        self.symbols = try alloc.alloc(elf.Elf64_Sym, bytes.len / @sizeOf(elf.Elf64_Sym));
+        for (self.symbols, 0..) |*sym, i| sym.* = try read(elf.Elf64_Sym, bytes, i * @sizeOf(elf.Elf64_Sym));
+        break;
+    }
+
+    return self;
+}
+
+fn deinit(self: *@This()) void {
+    self.alloc.free(self.sections);
+    self.alloc.free(self.symbols);
+    self.alloc.free(self.image);
+    self.names.deinit();
+    self.got.deinit();
+}
+
+fn read(comptime T: type, bytes: []const u8, offset: u64) Error!T {
+    if (offset + @sizeOf(T) > bytes.len) return error.InvalidObject;
+    return std.mem.bytesToValue(T, bytes[@intCast(offset)..][0..@sizeOf(T)]);
+}
+
+fn contents(self: @This(), header: elf.Elf64_Shdr) Error![]const u8 {
+    if (header.sh_type == elf.SHT_NOBITS) return &.{};
+    if (header.sh_offset + header.sh_size > self.object.len) return error.InvalidObject;
+    return self.object[@intCast(header.sh_offset)..][0..@intCast(header.sh_size)];
+}
+
+fn name(self: @This(), sym: elf.Elf64_Sym) []const u8 {
+    if (sym.st_name >= self.strtab.len) return "";
+    return std.mem.sliceTo(self.strtab[sym.st_name..], 0);
+}
+
+fn isGot(t: u32) bool {
+    return t == R_GOTPCREL or t == R_GOTPCRELX or t == R_REX_GOTPCRELX;
+}
+
+// File offsets and addresses move together, every segment starts on its own
+// page with the headers alone in the first one. The GOT goes after the data
+fn layout(self: *@This()) Error!void {
+    for (self.sections) |*s| {
+        const flags = s.header.sh_flags;
+        if (flags & elf.SHF_ALLOC == 0) continue;
+        if (flags & elf.SHF_TLS != 0) {
+            Logger.log.err("Thread local sections are not supported", .{});
+            return error.UnsupportedObject;
+        }
+
+        s.segment = if (flags & elf.SHF_EXECINSTR != 0) .code else if (flags & elf.SHF_WRITE != 0) .data else .rodata;
+    }
+
+    for (self.sections) |s| {
+        if (s.header.sh_type != elf.SHT_RELA or s.header.sh_info >= self.sections.len) continue;
+        if (self.sections[s.header.sh_info].segment == null) continue;
+
+        const bytes = try self.contents(s.header);
+        for (0..bytes.len / @sizeOf(elf.Elf64_Rela)) |i| {
+            const rela = try read(elf.Elf64_Rela, bytes, i * @sizeOf(elf.Elf64_Rela));
+            if (isGot(rela.r_type())) try self.got.put(rela.r_sym(), {});
+        }
+    }
+
+    var cursor: u64 = page;
+    var end: u64 = 0;
+    for ([_]Segment{ .code, .rodata, .data }) |segment| {
+        cursor = std.mem.alignForward(u64, cursor, page);
+        const start = cursor;
+
+        for (self.sections) |*s| {
+            if (s.segment != segment or s.header.sh_type == elf.SHT_NOBITS) continue;
+            cursor = std.mem.alignForward(u64, cursor, @max(s.header.sh_addralign, 1));
+            s.offset = cursor;
+            s.addr = base + cursor;
+            cursor += s.header.sh_size;
+        }
+
+        if (segment == .data and self.got.count() > 0) {
+            cursor = std.mem.alignForward(u64, cursor, 8);
+            self.gotOffset = cursor;
+            cursor += 8 * self.got.count();
+        }
+
+        // Zero filled sections only take memory, past the end of the file part
+        const fileEnd = cursor;
+        for (self.sections) |*s| {
+            if (s.segment != segment or s.header.sh_type != elf.SHT_NOBITS) continue;
+            cursor = std.mem.alignForward(u64, cursor, @max(s.header.sh_addralign, 1));
+            s.addr = base + cursor;
+            cursor += s.header.sh_size;
+        }
+
+        if (cursor == start) continue;
+        end = fileEnd;
+        self.phdrs.appendAssumeCapacity(.{
+            .p_type = elf.PT_LOAD,
+            .p_flags = switch (segment) {
+                .code => elf.PF_R | elf.PF_X,
+                .rodata => elf.PF_R,
+                .data => elf.PF_R | elf.PF_W,
+            },
+            .p_offset = start,
+            .p_vaddr = base + start,
+            .p_paddr = base + start,
+            .p_filesz = fileEnd - start,
+            .p_memsz = cursor - start,
+            .p_align = page,
+        });
+    }
+
+    // Room for the headers even if nothing is loaded
+    self.image = try self.alloc.alloc(u8, @max(end, page));
+    @memset(self.image, 0);
+    for (self.sections) |s| {
+        if (s.segment == null) continue;
+        const bytes = try self.contents(s.header);
+        @memcpy(self.image[@intCast(s.offset)..][0..bytes.len], bytes);
+    }
+}
+
+// Names are only taken from globals first, an extern with the same name as a
+// private function still finds it
+fn define(self: *@This()) Error!void {
+    for ([_]bool{ true, false }) |global| {
+        for (self.symbols) |sym| {
+            if ((sym.st_bind() != elf.STB_LOCAL) != global) continue;
+            if (sym.st_shndx == elf.SHN_UNDEF or sym.st_shndx == elf.SHN_COMMON) continue;
+            if (sym.st_type() == elf.STT_SECTION or sym.st_type() == elf.STT_FILE) continue;
+
+            const n = self.name(sym);
+            if (n.len == 0) continue;
+            const entry = try self.names.getOrPut(n);
+            if (!entry.found_existing) entry.value_ptr.* = try self.address(sym);
+        }
+    }
+}
+
+fn address(self: @This(), sym: elf.Elf64_Sym) Error!u64 {
+    switch (sym.st_shndx) {
+        elf.SHN_UNDEF => return self.names.get(self.name(sym)) orelse {
+            Logger.log.err("Undefined symbol {s}", .{self.name(sym)});
+            return error.UndefinedSymbol;
+        },
+        elf.SHN_ABS => return sym.st_value,
+        elf.SHN_COMMON => {
+            Logger.log.err("Common symbol {s} is not supported", .{self.name(sym)});
+            return error.UnsupportedObject;
+        },
+        else => {
+            if (sym.st_shndx >= self.sections.len) return error.InvalidObject;
+            const s = self.sections[sym.st_shndx];
+            if (s.segment == null) return error.InvalidObject;
+            return s.addr + sym.st_value;
+        },
+    }
+}
+
+fn relocate(self: *@This()) Error!void {
+    for (self.sections) |s| {
+        if (s.header.sh_type == elf.SHT_REL) {
+            Logger.log.err("Relocations without addend are not supported", .{});
+            return error.UnsupportedObject;
+        }
+        if (s.header.sh_type != elf.SHT_RELA or s.header.sh_info >= self.sections.len) continue;
+        const target = self.sections[s.header.sh_info];
+        if (target.segment == null) continue;
+        if (target.header.sh_type == elf.SHT_NOBITS) return error.InvalidObject;
+
+        const bytes = try self.contents(s.header);
+        for (0..bytes.len / @sizeOf(elf.Elf64_Rela)) |i| {
+            const rela = try read(elf.Elf64_Rela, bytes, i * @sizeOf(elf.Elf64_Rela));
+            if (rela.r_sym() >= self.symbols.len) return error.InvalidObject;
+
+            const sym: i128 = if (rela.r_sym() == 0) 0 else try self.address(self.symbols[rela.r_sym()]);
+            const addend: i128 = rela.r_addend;
+            const place: i128 = target.addr + rela.r_offset;
+            const site = self.image[@intCast(target.offset + rela.r_offset)..];
+
+            switch (rela.r_type()) {
+                R_64 => try self.write(u64, site, sym + addend),
+                R_PC64 => try self.write(i64, site, sym + addend - place),
+                R_PC32, R_PLT32 => try self.write(i32, site, sym + addend - place),
+                R_32 => try self.write(u32, site, sym + addend),
+                R_32S => try self.write(i32, site, sym + addend),
+                R_GOTPCREL, R_GOTPCRELX, R_REX_GOTPCRELX => {
+                    const slot = self.gotOffset + 8 * self.got.getIndex(rela.r_sym()).?;
+                    std.mem.writeInt(u64, self.image[@intCast(slot)..][0..8], @intCast(sym), .little);
+                    try self.write(i32, site, base + slot + addend - place);
+                },
+                else => {
+                    Logger.log.err("Unsupported relocation type {}", .{rela.r_type()});
+                    return error.UnsupportedObject;
+                },
+            }
+        }
+    }
+}
+
+fn write(self: @This(), comptime T: type, site: []u8, v: i128) Error!void {
+    _ = self;
+    if (site.len < @sizeOf(T)) return error.InvalidObject;
+    // 64 bit absolute values wrap, everything narrower has to fit
+    if (@sizeOf(T) < 8 and (v < std.math.minInt(T) or v > std.math.maxInt(T))) return error.RelocationOverflow;
+
+    const U = std.meta.Int(.unsigned, @bitSizeOf(T));
+    std.mem.writeInt(U, site[0..@sizeOf(T)], @truncate(@as(u128, @bitCast(v))), .little);
+}
+
+fn writeHeaders(self: *@This(), entry: u64) void {
+    var ident = [_]u8{0} ** elf.EI_NIDENT;
+    @memcpy(ident[0..4], elf.MAGIC);
+    ident[elf.EI_CLASS] = elf.ELFCLASS64;
+    ident[elf.EI_DATA] = elf.ELFDATA2LSB;
+    ident[elf.EI_VERSION] = 1;
+
+    const ehdr = elf.Elf64_Ehdr{
+        .e_ident = ident,
+        .e_type = .EXEC,
+        .e_machine = .X86_64,
+        .e_version = 1,
+        .e_entry = entry,
+        .e_phoff = @sizeOf(elf.Elf64_Ehdr),
+        .e_shoff = 0,
+        .e_flags = 0,
+        .e_ehsize = @sizeOf(elf.Elf64_Ehdr),
+        .e_phentsize = @sizeOf(elf.Elf64_Phdr),
+        .e_phnum = @intCast(self.phdrs.len),
+        .e_shentsize = @sizeOf(elf.Elf64_Shdr),
+        .e_shnum = 0,
+        .e_shstrndx = 0,
+    };
+
+    @memcpy(self.image[0..@sizeOf(elf.Elf64_Ehdr)], std.mem.asBytes(&ehdr));
+    @memcpy(self.image[@sizeOf(elf.Elf64_Ehdr)..][0 .. self.phdrs.len * @sizeOf(elf.Elf64_Phdr)], std.mem.sliceAsBytes(self.phdrs.constSlice()));
+}
@@ -1,20 +1,38 @@
 const std = @import("std");
 
+// Part of the cache key, bump when codegen changes
+pub const version = "0.2.0";
+
 pub fn usage() void {
     std.debug.print(
         \\    Usage:
-        \\    PePe <subcommand> <file> <...args> -- <...executable args>
+        \\    PePe <subcommand> <files | directories | -> <...args> -- <...executable args>
         \\    Subcomands
-        \\        build Compiles file
+        \\        build Compiles the files, every .yt file of a directory is included
         \\        run Compiles file and runs the executable
         \\        sim Interpreter of the same language
         \\        lex Output the tokens of the file
         \\        parse Output the AST of the file
         \\        ir Output the intermediate representation of the file
+        \\        asm Output the machine code listing and the size of every function
+        \\        serve Keeps a compiler warm and runs the requests of clients
+        \\        client <subcommand> ... Has the server run the subcommand
         \\    Arguments
         \\        -b - Benchs the stages the compiler goes through
         \\        -s - No output from the compiler except errors
         \\        -stdout - Insted of creating a file it prints the content
+        \\        -no-mmap - Read the source into memory instead of mapping it
+        \\        -no-cache - Build every function instead of reusing .yot-cache
+        \\        -O0 -O1 -O2 - No optimization (default), builder peepholes, tb_opt
+        \\        -json - asm outputs the size table as JSON
+        \\        -jit-heap=<size> - Size of each JIT code chunk, k m g suffixes (default 4m)
+        \\        -march=native|baseline|<list> - CPU features codegen may use, a list like popcnt,bmi1,bmi2
+        \\        -tiered - run starts main unoptimized and rebuilds it at -O2 once it is hot
+        \\        -tier-up=<n> - Calls of main before -tiered rebuilds it (default 100)
+        \\        -socket=<path> - Unix socket of serve and client (default /tmp/yot.sock)
+        \\        -repeat=<n> - client sends the request n times and reports requests/s
+        \\        -safe - Integer overflow traps instead of wrapping
+        \\        -fast - Integer overflow is assumed to never happen
         \\
     , .{});
 }
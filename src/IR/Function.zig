@@ -3,45 +3,91 @@ const std = @import("std");
 const Parser = @import("../Parser/Parser.zig");
 const Primitive = Parser.Primitive;
 const Function = Parser.Function;
+const Ast = Parser.Ast;
+const Location = @import("../Lexer/Location.zig");
 
 const IR = @import("IR.zig");
 const Instruction = IR.Instruction;
 
 const tb = @import("../libs/tb/tb.zig");
 const tbHelper = @import("../TBHelper.zig");
+const Overflow = @import("../ParseArgs.zig").Overflow;
 
 name: []const u8,
+id: u32,
 //args: void,
 body: std.ArrayList(Instruction),
+// Number of lets, each one owns a slot
+locals: u32 = 0,
 returnType: Primitive,
-func: tb.Function,
+// Null when the machine code came from the cache, there is nothing to lower
+func: ?tb.Function,
+cacheKey: ?u64 = null,
 externSymbol: *tb.Symbol,
 prototype: *tb.FunctionPrototype,
+// Expression pool of the file the function comes from
+ast: *const Ast,
+loc: Location,
 
-pub fn init(alloc: std.mem.Allocator, f: Parser.Function, m: tb.Module) @This() {
+pub fn init(alloc: std.mem.Allocator, f: Parser.Function, ast: *const Ast, m: tb.Module) @This() {
     return @This(){
         .name = f.name,
+        .id = f.id,
         .body = std.ArrayList(IR.Instruction).init(alloc),
         .returnType = f.returnType,
         .func = m.functionCreate(f.name, tb.Linkage.PRIVATE),
         .externSymbol = m.externCreate(f.name, tb.ExternalType.SO_LOCAL),
         .prototype = tbHelper.getPrototype(m, f.returnType),
+        .ast = ast,
+        .loc = f.loc,
     };
 }
 
-pub fn codeGen(self: @This(), alloc: std.mem.Allocator, m: tb.Module, funcWS: ?tb.Worklist) std.mem.Allocator.Error!tb.Function {
-    var scope = std.StringHashMap(*tb.Node).init(alloc);
+// The cached bytes go in a global of an executable section under the function
+// name, so callers link against it exactly like against a compiled function
+pub fn initCached(alloc: std.mem.Allocator, f: Parser.Function, ast: *const Ast, m: tb.Module, section: tb.ModuleSectionHandle, code: []const u8) @This() {
+    const global = m.globalCreate(f.name, tb.Linkage.PUBLIC);
+    m.globalSetStorage(section, global, code.len, 16, 1);
+    @memcpy(m.globalAddRegion(global, 0, code.len), code);
+
+    return @This(){
+        .name = f.name,
+        .id = f.id,
+        .body = std.ArrayList(IR.Instruction).init(alloc),
+        .returnType = f.returnType,
+        .func = null,
+        .externSymbol = m.externCreate(f.name, tb.ExternalType.SO_LOCAL),
+        .prototype = tbHelper.getPrototype(m, f.returnType),
+        .ast = ast,
+        .loc = f.loc,
+    };
+}
+
+pub fn codeGen(self: @This(), alloc: std.mem.Allocator, m: tb.Module, funcWS: ?tb.Worklist, overflow: Overflow, counter: ?*u64) std.mem.Allocator.Error!tb.Function {
+    return self.build(alloc, m, self.func.?, funcWS, overflow, counter);
+}
+
+// Into any function, the tiered JIT builds main a second time into a new one.
+// With a counter every call first bumps it, the address is baked into the code
+pub fn build(self: @This(), alloc: std.mem.Allocator, m: tb.Module, func: tb.Function, funcWS: ?tb.Worklist, overflow: Overflow, counter: ?*u64) std.mem.Allocator.Error!tb.Function {
+    const scope = try alloc.alloc(IR.Variable.Binding, self.locals);
+    defer alloc.free(scope);
 
     const textSection = m.getText();
 
-    const func = self.func;
     const funcPrototype = self.prototype;
 
     const g = func.graphBuilderEnter(textSection, funcPrototype, funcWS);
     defer g.exit();
 
+    if (counter) |c| {
+        const addr = g.uint(tb.createPTR(), @intFromPtr(c));
+        const calls = g.load(0, false, tb.typeI64(), addr, 8, false);
+        g.store(0, false, addr, g.binopInt(tb.NodeType.ADD, calls, g.uint(tb.typeI64(), 1), tb.ArithmeticBehavior.NONE), 8, false);
+    }
+
     for (self.body.items) |inst| {
-        try inst.codeGen(g, self, &scope);
+        inst.codeGen(g, self, scope, overflow);
     }
 
     return func;
@@ -73,6 +119,6 @@ pub fn toString(self: @This(), cont: *std.ArrayList(u8), d: u64) std.mem.Allocat
     try cont.appendSlice("Body:\n");
 
     for (self.body.items) |inst| {
-        try inst.toString(cont, d + 4);
+        try inst.toString(self.ast, cont, d + 4);
     }
 }
@@ -13,18 +13,20 @@ pub const Function = @import("./Function.zig");
 pub const Program = @import("./Program.zig");
 pub const Variable = @import("./Variable.zig");
 
+const Cache = @import("../Cache.zig");
+const CodeGen = @import("../CodeGen.zig");
+const Overflow = @import("../ParseArgs.zig").Overflow;
+
 const tb = @import("../libs/tb/tb.zig");
 const tbHelper = @import("../TBHelper.zig");
 
-program: *Parser.Program,
 ir: Program,
 alloc: std.mem.Allocator,
 
-pub fn init(p: *Parser.Program, alloc: std.mem.Allocator) @This() {
+pub fn init(alloc: std.mem.Allocator, cache: ?*Cache) @This() {
     return @This(){
         .alloc = alloc,
-        .program = p,
-        .ir = Program.init(alloc),
+        .ir = Program.init(alloc, cache),
     };
 }
 
@@ -32,27 +34,55 @@ pub fn deinit(self: *@This()) void {
     self.ir.deinit();
 }
 
-pub fn toIR(self: *@This(), m: tb.Module) std.mem.Allocator.Error!void {
-    var it = self.program.funcs.iterator();
-    while (it.next()) |c| {
-        const func = c.value_ptr.*;
-        const f = try func.toIR(self.alloc, &self.ir, m);
-
-        try self.ir.funcs.put(f.name, f);
+// Called once per file in command line order, so duplicate symbols are always
+// reported against the same definition. Returns false if any name was taken
+// or could not be resolved
+pub fn toIR(self: *@This(), program: *Parser.Program, m: tb.Module) std.mem.Allocator.Error!bool {
+    var ok = true;
+    for (program.funcs.items) |func| {
+        if (!try self.ir.define(func, &program.ast, m)) ok = false;
     }
-}
 
-pub fn codeGen(self: *@This(), m: tb.Module) std.mem.Allocator.Error!tb.Function {
-    const ws = tb.Worklist.alloc();
-    defer ws.free();
+    return ok;
+}
 
+// Graph sizes around tb_opt and the time spent building and optimizing them
+pub const OptStats = struct {
+    functions: u64 = 0,
+    nodesBuilt: u64 = 0,
+    nodesOptimized: u64 = 0,
+    buildNs: u64 = 0,
+    optNs: u64 = 0,
+};
+
+// From level 1 the builder gets the worklist, which enables its peepholes,
+// level 2 runs tb_opt on every function until it stops making progress.
+// With counters, indexed by function id, every function counts its calls
+pub fn codeGen(self: *@This(), m: tb.Module, ws: tb.Worklist, level: u2, overflow: Overflow, stats: ?*OptStats, counters: ?[]u64) std.mem.Allocator.Error!tb.Function {
     const sectionText = m.getText();
+    var timer = std.time.Timer.start() catch unreachable;
 
     var funcIterator = self.ir.funcs.valueIterator();
 
     while (funcIterator.next()) |func| {
-        // _ = func.codeGen(m, ws);
-        _ = try func.codeGen(self.alloc, m, null);
+        if (func.func == null) continue;
+        const counter = if (counters) |c| &c[func.id] else null;
+        const f = try func.codeGen(self.alloc, m, if (level >= 1) ws else null, overflow, counter);
+        if (stats) |s| {
+            s.functions += 1;
+            s.buildNs += timer.lap();
+            s.nodesBuilt += try f.nodeCount(self.alloc);
+        }
+
+        if (level >= 2) {
+            while (f.opt(ws, false)) {}
+        }
+
+        if (stats) |s| {
+            s.optNs += timer.lap();
+            s.nodesOptimized += try f.nodeCount(self.alloc);
+            _ = timer.lap();
+        }
     }
 
     const startF = m.functionCreate("_start", tb.Linkage.PUBLIC);
@@ -62,7 +92,7 @@ pub fn codeGen(self: *@This(), m: tb.Module) std.mem.Allocator.Error!tb.Function
         const g = startF.graphBuilderEnter(sectionText, startP, ws);
         defer g.exit();
 
-        const irMain = self.ir.funcs.get("main").?;
+        const irMain = self.ir.lookup("main").?;
 
         const mainExtern = irMain.externSymbol;
         const mainPrototype = irMain.prototype;
@@ -79,6 +109,21 @@ pub fn codeGen(self: *@This(), m: tb.Module) std.mem.Allocator.Error!tb.Function
     return startF;
 }
 
+// One job per function that still needs machine code, _start first and the
+// rest in source order so the output does not depend on the hash map
+pub fn codeGenJobs(self: *@This(), startF: tb.Function) std.mem.Allocator.Error![]CodeGen.Job {
+    var jobs = std.ArrayList(CodeGen.Job).init(self.alloc);
+    try jobs.append(.{ .name = "_start", .f = startF });
+
+    for (self.ir.idens.names.items, 0..) |_, id| {
+        const func = self.ir.funcs.get(@intCast(id)) orelse continue;
+        const f = func.func orelse continue;
+        try jobs.append(.{ .name = func.name, .f = f, .cacheKey = func.cacheKey });
+    }
+
+    return jobs.toOwnedSlice();
+}
+
 pub fn toString(self: *@This(), alloc: std.mem.Allocator) std.mem.Allocator.Error!std.ArrayList(u8) {
     var cont = std.ArrayList(u8).init(alloc);
 
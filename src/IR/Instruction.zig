@@ -8,32 +8,34 @@ const Variable = IR.Variable;
 
 const Parser = @import("../Parser/Parser.zig");
 const Statement = Parser.Statement;
+const Ast = Parser.Ast;
 
 const tb = @import("../libs/tb/tb.zig");
 const tbHelper = @import("../TBHelper.zig");
+const Overflow = @import("../ParseArgs.zig").Overflow;
 
 pub const Instruction = union(enum) {
     intrinsic: Intrinsic,
     ret: Return,
     variable: Variable,
 
-    pub fn codeGen(self: @This(), g: tb.GraphBuilder, f: IR.Function, scope: *std.StringHashMap(*tb.Node)) std.mem.Allocator.Error!void {
+    pub fn codeGen(self: @This(), g: tb.GraphBuilder, f: IR.Function, scope: []Variable.Binding, overflow: Overflow) void {
         switch (self) {
             .ret => |ret| {
                 Logger.log.warn("Only parsing expr of return value as unsigned and I assume there is a return of unsigned", .{});
-                var node = ret.expr.codeGen(g, scope, f.returnType, tbHelper.getType(f.returnType));
+                var node = ret.expr.codeGen(f.ast, g, scope, tbHelper.getType(f.returnType), overflow);
                 g.ret(0, 1, @ptrCast(&node));
             },
             .intrinsic => unreachable,
-            .variable => |v| try scope.put(v.name, v.codeGen(g, scope)),
+            .variable => |v| scope[v.slot] = v.codeGen(f.ast, g, scope, overflow),
         }
     }
 
-    pub fn toString(self: @This(), cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
+    pub fn toString(self: @This(), ast: *const Ast, cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
         switch (self) {
-            .intrinsic => |in| try in.toString(cont, d),
-            .ret => |in| try in.toString(cont, d),
-            .variable => |in| try in.toString(cont, d),
+            .intrinsic => |in| try in.toString(ast, cont, d),
+            .ret => |in| try in.toString(ast, cont, d),
+            .variable => |in| try in.toString(ast, cont, d),
         }
     }
 };
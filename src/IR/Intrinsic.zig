@@ -2,6 +2,7 @@ const std = @import("std");
 
 const Parser = @import("../Parser/Parser.zig");
 const Expression = Parser.Expression;
+const Ast = Parser.Ast;
 
 const tb = @import("../libs/tb/tb.zig");
 
@@ -15,7 +16,7 @@ fn init(alloc: std.mem.Allocator, name: []const u8) @This() {
     };
 }
 
-pub fn toString(self: @This(), cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
+pub fn toString(self: @This(), ast: *const Ast, cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
     for (0..d) |_|
         try cont.append(' ');
 
@@ -27,7 +28,7 @@ pub fn toString(self: @This(), cont: *std.ArrayList(u8), d: u64) std.mem.Allocat
         if (i > 0)
             try cont.appendSlice(", ");
 
-        try arg.toString(cont, d);
+        try arg.toString(ast, cont, d);
     }
 
     try cont.append(')');
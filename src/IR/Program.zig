@@ -1,24 +1,85 @@
 const std = @import("std");
+const Logger = @import("../Logger.zig");
 
 const IR = @import("IR.zig");
 const Function = IR.Function;
 
-funcs: std.StringHashMap(Function),
+const Parser = @import("../Parser/Parser.zig");
+const Ast = Parser.Ast;
 
-pub fn toString(self: @This(), cont: *std.ArrayList(u8)) std.mem.Allocator.Error!void {
-    var it = self.funcs.iterator();
+const Intern = @import("../Lexer/Intern.zig");
+
+const Cache = @import("../Cache.zig");
+
+const tb = @import("../libs/tb/tb.zig");
 
-    while (it.next()) |state| {
-        try state.value_ptr.toString(cont, 0);
+// Keyed by the id of the function name in idens, shared by every file
+funcs: std.AutoHashMap(u32, Function),
+idens: Intern,
+alloc: std.mem.Allocator,
+cache: ?*Cache,
+// Executable section for the cached functions, created on the first hit
+cacheSection: ?tb.ModuleSectionHandle = null,
+
+pub fn toString(self: @This(), cont: *std.ArrayList(u8)) std.mem.Allocator.Error!void {
+    // Same order as the sources, not hash order
+    for (self.idens.names.items, 0..) |_, id| {
+        const f = self.funcs.get(@intCast(id)) orelse continue;
+        try f.toString(cont, 0);
     }
 }
 
-pub fn init(alloc: std.mem.Allocator) @This() {
+pub fn init(alloc: std.mem.Allocator, cache: ?*Cache) @This() {
     return .{
-        .funcs = std.StringHashMap(Function).init(alloc),
+        .funcs = std.AutoHashMap(u32, Function).init(alloc),
+        .idens = .{},
+        .alloc = alloc,
+        .cache = cache,
     };
 }
 
 pub fn deinit(self: *@This()) void {
     self.funcs.deinit();
+    self.idens.deinit(self.alloc);
+}
+
+pub fn lookup(self: @This(), name: []const u8) ?Function {
+    return self.funcs.get(self.idens.lookup(name) orelse return null);
+}
+
+// Returns false when the name is already taken, the first definition wins
+pub fn define(self: *@This(), func: Parser.Function, ast: *Ast, m: tb.Module) std.mem.Allocator.Error!bool {
+    const id = try self.idens.intern(self.alloc, func.name);
+    if (self.funcs.get(id)) |prev| {
+        Logger.logLocation.err(func.loc, "Function {s} is already defined", .{func.name});
+        Logger.logLocation.info(prev.loc, "Previous definition of {s}", .{func.name});
+        return false;
+    }
+
+    var key: ?u64 = null;
+    if (self.cache) |cache| {
+        const k = cache.key(func.loc.lexer, func.firstToken, func.endToken);
+        if (cache.load(k)) |code| {
+            var f = Function.initCached(self.alloc, func, ast, m, self.getCacheSection(m), code);
+            f.id = id;
+            try self.funcs.put(id, f);
+            return true;
+        }
+        key = k;
+    }
+
+    var f = try func.toIR(self.alloc, ast, self, m) orelse return false;
+    f.id = id;
+    f.cacheKey = key;
+    try self.funcs.put(id, f);
+
+    return true;
+}
+
+fn getCacheSection(self: *@This(), m: tb.Module) tb.ModuleSectionHandle {
+    if (self.cacheSection) |section| return section;
+
+    const section = m.createSection(".text.cached", tb.ModuleSectionFlags.EXEC, tb.ComdatType.NONE);
+    self.cacheSection = section;
+    return section;
 }
@@ -1,40 +1,56 @@
 const std = @import("std");
 
 const Parser = @import("./../Parser/Parser.zig");
+const Ast = Parser.Ast;
 
 const Lexer = @import("./../Lexer/Lexer.zig");
 
 const tb = @import("../libs/tb/tb.zig");
 const tbHelper = @import("../TBHelper.zig");
+const Overflow = @import("../ParseArgs.zig").Overflow;
 
 mut: bool,
 
 name: []const u8,
+id: u32,
+// Dense index in the function, set when the function is lowered
+slot: u32 = 0,
 loc: Lexer.Location,
 
 t: Parser.Primitive,
-expr: *Parser.Expression,
+expr: Parser.Expression,
 
 pub fn init(r: Parser.Variable) @This() {
     return @This(){
         .mut = r.mut,
         .name = r.name,
+        .id = r.id,
         .loc = r.loc,
         .t = r.t,
         .expr = r.expr,
     };
 }
 
-pub fn codeGen(self: @This(), g: tb.GraphBuilder, scope: *std.StringHashMap(*tb.Node)) *tb.Node {
-    std.debug.assert(self.t.size % 8 == 0);
-    const addr = g.local(self.t.size / 8, self.t.size / 8);
+// What a slot holds during codegen. An immutable let is just its value node,
+// a mutable one is a builder variable that TB keeps in SSA form
+pub const Binding = struct {
+    t: Parser.Primitive,
+    value: union(enum) {
+        node: *tb.Node,
+        variable: c_int,
+    },
+};
 
-    g.store(0, false, addr, self.expr.codeGen(g, scope, self.t, tbHelper.getType(self.t)), self.t.size / 8, false);
+pub fn codeGen(self: @This(), ast: *const Ast, g: tb.GraphBuilder, scope: []const Binding, overflow: Overflow) Binding {
+    const value = self.expr.codeGen(ast, g, scope, tbHelper.getType(self.t), overflow);
+    if (!self.mut) return .{ .t = self.t, .value = .{ .node = value } };
 
-    return addr;
+    const id = g.decl(g.labelGet());
+    g.setVar(id, value);
+    return .{ .t = self.t, .value = .{ .variable = id } };
 }
 
-pub fn toString(self: @This(), cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
+pub fn toString(self: @This(), ast: *const Ast, cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
     for (0..d) |_|
         try cont.append(' ');
 
@@ -45,6 +61,6 @@ pub fn toString(self: @This(), cont: *std.ArrayList(u8), d: u64) std.mem.Allocat
     try cont.append(' ');
     try self.t.toString(cont);
     try cont.appendSlice(" = ");
-    try self.expr.toString(cont, d);
+    try self.expr.toString(ast, cont, d);
     try cont.append('\n');
 }
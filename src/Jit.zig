@@ -0,0 +1,108 @@
+const std = @import("std");
+const Logger = @import("Logger.zig");
+
+const tb = @import("libs/tb/tb.zig");
+
+// Executable memory for JITed functions. A TB heap has a fixed capacity, so when
+// a function fits in none of the chunks another one is mapped for it. Functions
+// do not call each other yet, nothing has to be within rel32 of anything else.
+// Replaced and dropped functions give their memory back to the chunk they came from
+const Chunk = struct {
+    jit: tb.Jit,
+    capacity: usize,
+    used: usize = 0,
+};
+
+// The tiered JIT places a second version of a function next to the first
+pub const Key = struct {
+    id: u32,
+    tier: u8 = 0,
+};
+
+const Placement = struct {
+    chunk: u32,
+    code: *anyopaque,
+    size: usize,
+};
+
+m: tb.Module,
+chunkSize: usize,
+chunks: std.ArrayList(Chunk),
+// What is placed right now
+placed: std.AutoHashMap(Key, Placement),
+
+pub fn init(alloc: std.mem.Allocator, m: tb.Module, chunkSize: usize) @This() {
+    return @This(){
+        .m = m,
+        .chunkSize = chunkSize,
+        .chunks = std.ArrayList(Chunk).init(alloc),
+        .placed = std.AutoHashMap(Key, Placement).init(alloc),
+    };
+}
+
+pub fn deinit(self: *@This()) void {
+    for (self.chunks.items) |c| c.jit.end();
+    self.chunks.deinit();
+    self.placed.deinit();
+}
+
+// Code is 16 byte aligned and the heap keeps a header in front of it
+fn footprint(size: usize) usize {
+    return std.mem.alignForward(usize, size, 16) + 16;
+}
+
+// Replaces whatever was placed under the same key. TB keeps the address in the
+// function, so a dropped function has to be built again before it is placed.
+// The footprint is a guess, when the chunk turns it down anyway (a bigger header
+// or a fragmented heap) the function gets a fresh chunk of its own
+pub fn place(self: *@This(), key: Key, f: tb.Function, size: usize) std.mem.Allocator.Error!?*anyopaque {
+    self.drop(key);
+
+    const need = footprint(size);
+    var i = try self.chunkFor(need);
+    var code = self.chunks.items[i].jit.placeFunction(f);
+    if (code == null) {
+        i = try self.map(2 * need);
+        code = self.chunks.items[i].jit.placeFunction(f);
+    }
+
+    const placed = code orelse return null;
+    self.chunks.items[i].used += need;
+
+    try self.placed.put(key, .{ .chunk = i, .code = placed, .size = need });
+    return placed;
+}
+
+pub fn drop(self: *@This(), key: Key) void {
+    const kv = self.placed.fetchRemove(key) orelse return;
+    const c = &self.chunks.items[kv.value.chunk];
+    c.jit.freeObj(kv.value.code);
+    c.used -= kv.value.size;
+}
+
+// First chunk with room, a new one is at least twice the function so it does not fill up at once
+fn chunkFor(self: *@This(), need: usize) std.mem.Allocator.Error!u32 {
+    for (self.chunks.items, 0..) |c, i| {
+        if (c.capacity - c.used >= need) return @intCast(i);
+    }
+
+    return self.map(@max(self.chunkSize, 2 * need));
+}
+
+fn map(self: *@This(), size: usize) std.mem.Allocator.Error!u32 {
+    const capacity = std.mem.alignForward(usize, size, std.mem.page_size);
+    try self.chunks.append(.{ .jit = tb.Jit.begin(self.m, capacity), .capacity = capacity });
+    return @intCast(self.chunks.items.len - 1);
+}
+
+pub fn report(self: @This()) void {
+    var used: usize = 0;
+    var capacity: usize = 0;
+    for (self.chunks.items) |c| {
+        used += c.used;
+        capacity += c.capacity;
+        c.jit.dumpHeap();
+    }
+
+    Logger.log.info("JIT heap {} functions in {} chunks, {} of {} bytes used", .{ self.placed.count(), self.chunks.items.len, used, capacity });
+}
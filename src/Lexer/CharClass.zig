@@ -0,0 +1,79 @@
+const std = @import("std");
+
+const Lexer = @import("Lexer.zig");
+
+pub const Class = enum(u8) {
+    ignore,
+    separator,
+    symbol,
+    word,
+};
+
+// One entry per byte, everything that is not whitespace, a separator or a symbol
+// continues an identifier/number run, same as the old listContains chain
+pub const table: [256]Class = blk: {
+    var result = [_]Class{.word} ** 256;
+
+    for (Lexer.separatorIgnore) |c| result[c] = .ignore;
+    for (Lexer.separator) |c| {
+        if (result[c] == .word) result[c] = .separator;
+    }
+    for (Lexer.symbols) |c| result[c] = .symbol;
+
+    break :blk result;
+};
+
+pub inline fn get(c: u8) Class {
+    return table[c];
+}
+
+pub inline fn isIgnore(c: u8) bool {
+    return table[c] == .ignore;
+}
+
+pub inline fn isWord(c: u8) bool {
+    return table[c] == .word;
+}
+
+// 16 bytes on SSE, 32 on AVX2, never more so the mask fits in an u32
+pub const vecLen = @min(std.simd.suggestVectorLength(u8) orelse 16, 32);
+pub const Chunk = @Vector(vecLen, u8);
+pub const Mask = std.meta.Int(.unsigned, vecLen);
+pub const MaskShift = std.math.Log2Int(Mask);
+
+inline fn splat(c: u8) Chunk {
+    return @splat(c);
+}
+
+pub inline fn load(content: []const u8, i: usize) Chunk {
+    std.debug.assert(i + vecLen <= content.len);
+    return content[i..][0..vecLen].*;
+}
+
+pub inline fn newlineMask(chunk: Chunk) Mask {
+    return @bitCast(chunk == splat('\n'));
+}
+
+pub inline fn ignoreMask(chunk: Chunk) Mask {
+    const space: Mask = @bitCast(chunk == splat(' '));
+    const tab: Mask = @bitCast(chunk == splat('\t'));
+    const cr: Mask = @bitCast(chunk == splat('\r'));
+    return space | tab | cr | newlineMask(chunk);
+}
+
+// Mirrors the table: printable ascii that is not alphanumeric or _ ends a word
+pub inline fn wordMask(chunk: Chunk) Mask {
+    const printable: Mask = @bitCast((chunk -% splat(33)) <= splat(126 - 33));
+    const alpha: Mask = @bitCast(((chunk | splat(0x20)) -% splat('a')) < splat(26));
+    const digit: Mask = @bitCast((chunk -% splat('0')) < splat(10));
+    const underscore: Mask = @bitCast(chunk == splat('_'));
+
+    const single = printable & ~(alpha | digit | underscore);
+    return ~(single | ignoreMask(chunk));
+}
+
+// Bits below n set, n can be the whole width
+pub inline fn lowBits(n: usize) Mask {
+    if (n >= vecLen) return std.math.maxInt(Mask);
+    return (@as(Mask, 1) << @as(MaskShift, @intCast(n))) - 1;
+}
@@ -0,0 +1,33 @@
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+
+// Identifier strings point into the source, only the slices are stored
+map: std.StringHashMapUnmanaged(u32) = .{},
+names: std.ArrayListUnmanaged([]const u8) = .{},
+
+pub fn deinit(self: *@This(), alloc: Allocator) void {
+    self.map.deinit(alloc);
+    self.names.deinit(alloc);
+}
+
+pub fn intern(self: *@This(), alloc: Allocator, str: []const u8) Allocator.Error!u32 {
+    const entry = try self.map.getOrPut(alloc, str);
+    if (!entry.found_existing) {
+        entry.value_ptr.* = @intCast(self.names.items.len);
+        try self.names.append(alloc, str);
+    }
+
+    return entry.value_ptr.*;
+}
+
+pub fn lookup(self: @This(), str: []const u8) ?u32 {
+    return self.map.get(str);
+}
+
+pub fn get(self: @This(), id: u32) []const u8 {
+    return self.names.items[id];
+}
+
+pub fn count(self: @This()) u32 {
+    return @intCast(self.names.items.len);
+}
@@ -3,9 +3,10 @@ const util = @import("./../Util.zig");
 
 const Logger = @import("../Logger.zig");
 
-const Arguments = @import("./../ParseArgs.zig").Arguments;
 
+pub const CharClass = @import("./CharClass.zig");
 pub const Location = @import("./Location.zig");
+pub const Intern = @import("./Intern.zig");
 pub const Token = @import("./Token.zig");
 pub const TokenType = Token.TokenType;
 
@@ -13,6 +14,14 @@ const Allocator = std.mem.Allocator;
 const print = std.debug.print;
 const assert = std.debug.assert;
 
+// 9 bytes per token, the Token struct is only built when the parser asks for it
+pub const Tokens = std.MultiArrayList(struct {
+    tag: TokenType,
+    start: u32,
+    // Length of the token, for .iden the intern id (the length is in the intern table)
+    data: u32,
+});
+
 const LexerCreationError = error{
     couldNotOpenFile,
     couldNotGetFileSize,
@@ -23,12 +32,17 @@ const LexerCreationError = error{
 path: []const u8,
 absPath: []const u8,
 content: []const u8,
-prevLoc: Location = Location{ .row = 1, .col = 1, .i = 0, .path = "", .content = "" },
-currentLoc: Location = Location{ .row = 1, .col = 1, .i = 0, .path = "", .content = "" },
+// Set when content is a mapping of the file instead of a heap copy
+mapped: ?[]align(std.mem.page_size) const u8 = null,
 index: usize = 0,
-peeked: usize = 0,
 finished: bool = false,
 
+tokens: Tokens = .{},
+idens: Intern = .{},
+cursor: u32 = 0,
+// Offset of every line start, only built once a diagnostic needs a row/col
+lineStarts: std.ArrayListUnmanaged(u32) = .{},
+
 alloc: Allocator,
 
 pub const separatorIgnore = " \t\n\r";
@@ -54,59 +68,153 @@ pub const symbols: [(127 - 33) - (26 * 2) - 10 - 5 - 1]u8 = blk: {
 };
 
 fn skipIgnore(self: *@This()) void {
-    while (self.index < self.content.len and util.listContains(u8, separatorIgnore, self.content[self.index])) {
-        if (self.content[self.index] == '\n') {
-            self.currentLoc.row += 1;
-            self.currentLoc.col = 0;
-        }
-        self.index += 1;
-        self.currentLoc.col += 1;
+    const content = self.content;
+    var i = self.index;
+
+    while (i + CharClass.vecLen <= content.len) {
+        const run = @ctz(~CharClass.ignoreMask(CharClass.load(content, i)));
+        i += run;
+        if (run < CharClass.vecLen) break;
+    } else {
+        while (i < content.len and CharClass.isIgnore(content[i])) : (i += 1) {}
     }
-    self.currentLoc.i = self.index;
+
+    self.index = i;
+}
+
+fn skipWord(content: []const u8, start: usize) usize {
+    var i = start;
+
+    while (i + CharClass.vecLen <= content.len) {
+        const run = @ctz(~CharClass.wordMask(CharClass.load(content, i)));
+        i += run;
+        if (run < CharClass.vecLen) return i;
+    }
+
+    while (i < content.len and CharClass.isWord(content[i])) : (i += 1) {}
+
+    return i;
 }
 
 pub fn advance(self: *@This()) ?usize {
     if (self.content.len == 0 or self.index >= self.content.len - 1) return null;
-    if (self.index < self.peeked) return self.peeked;
 
     self.skipIgnore();
-    self.prevLoc = self.currentLoc;
-    var i = self.index;
+    if (self.index >= self.content.len) return null;
+
+    var i = skipWord(self.content, self.index);
+
+    if (self.index == i) i += 1;
+
+    return i;
+}
 
-    while (i < self.content.len and !util.listContains(u8, separator, self.content[i]) and !util.listContains(u8, &symbols, self.content[i])) {
-        i += 1;
-        self.currentLoc.col += 1;
+pub fn tokenize(self: *@This()) Allocator.Error!void {
+    self.tokens.shrinkRetainingCapacity(0);
+    // Roughly one token every four bytes on the examples, saves most of the regrowth
+    try self.tokens.ensureTotalCapacity(self.alloc, self.content.len / 4 + 1);
+
+    while (self.advance()) |end| {
+        const text = self.content[self.index..end];
+        const tag = TokenType.get(text);
+
+        try self.tokens.append(self.alloc, .{
+            .tag = tag,
+            .start = @intCast(self.index),
+            .data = if (tag == .iden) try self.idens.intern(self.alloc, text) else @intCast(text.len),
+        });
+        self.index = end;
     }
 
-    if (self.index == i) {
-        i += 1;
-        self.currentLoc.col += 1;
+    try self.tokens.append(self.alloc, .{
+        .tag = .EOF,
+        .start = @intCast(self.index),
+        .data = 0,
+    });
+
+    self.cursor = 0;
+    self.finished = false;
+}
+
+fn buildLineStarts(self: *@This()) Allocator.Error!void {
+    try self.lineStarts.append(self.alloc, 0);
+
+    var i: usize = 0;
+    while (std.mem.indexOfScalarPos(u8, self.content, i, '\n')) |nl| {
+        i = nl + 1;
+        try self.lineStarts.append(self.alloc, @intCast(i));
     }
-    self.currentLoc.i = self.index;
+}
 
-    return i;
+// Row and column are 1 based, line is the text of the row without the newline
+pub fn position(self: *@This(), offset: u32) Location.Position {
+    if (self.lineStarts.items.len == 0) {
+        self.buildLineStarts() catch {
+            self.lineStarts.clearRetainingCapacity();
+            return .{ .row = 0, .col = 0, .line = "" };
+        };
+    }
+
+    const starts = self.lineStarts.items;
+
+    // Last line start that is not after the offset
+    var low: usize = 0;
+    var high: usize = starts.len;
+    while (high - low > 1) {
+        const mid = low + (high - low) / 2;
+        if (starts[mid] <= offset) low = mid else high = mid;
+    }
+
+    const begin = starts[low];
+    const end = if (low + 1 < starts.len) starts[low + 1] - 1 else self.content.len;
+
+    return .{
+        .row = low + 1,
+        .col = offset - begin + 1,
+        .line = self.content[begin..end],
+    };
 }
 
-pub fn peek(self: *@This()) Token {
-    self.peeked = self.advance() orelse {
-        if (self.finished) unreachable;
-        return Token.init(self.path, self.absPath, "", self.currentLoc);
+pub fn token(self: *@This(), i: u32) Token {
+    const tag = self.tokens.items(.tag)[i];
+    const start = self.tokens.items(.start)[i];
+    const data = self.tokens.items(.data)[i];
+
+    if (tag == .iden) return Token{
+        .type = tag,
+        .str = self.idens.get(data),
+        .id = data,
+        .loc = .{ .lexer = self, .i = start },
     };
 
-    return Token.init(self.path, self.absPath, self.content[self.index..self.peeked], self.prevLoc);
+    return Token{
+        .type = tag,
+        .str = self.content[start .. start + data],
+        .loc = .{ .lexer = self, .i = start },
+    };
+}
+
+pub fn str(self: *const @This(), i: u32) []const u8 {
+    const start = self.tokens.items(.start)[i];
+    const data = self.tokens.items(.data)[i];
+
+    if (self.tokens.items(.tag)[i] == .iden) return self.idens.get(data);
+    return self.content[start .. start + data];
+}
+
+pub fn peek(self: *@This()) Token {
+    return self.token(self.cursor);
 }
 
 pub fn pop(self: *@This()) Token {
-    const i = self.advance() orelse {
+    const t = self.token(self.cursor);
+
+    if (t.type == .EOF) {
         if (self.finished) unreachable;
         self.finished = true;
-        return Token.init(self.path, self.absPath, "", self.currentLoc);
-    };
-
-    const t = Token.init(self.path, self.absPath, self.content[self.index..i], self.prevLoc);
-
-    self.index = i;
-    self.prevLoc = self.currentLoc;
+    } else {
+        self.cursor += 1;
+    }
 
     return t;
 }
@@ -124,41 +232,66 @@ pub fn toString(self: *@This(), alloc: std.mem.Allocator) std.mem.Allocator.Erro
     return cont;
 }
 
-pub fn init(alloc: Allocator, path: []const u8) LexerCreationError!@This() {
-    const abspath = std.fs.realpathAlloc(alloc, path) catch return error.couldNotGetAbsolutePath;
-    const f = std.fs.openFileAbsolute(abspath, .{ .mode = .read_only }) catch return error.couldNotOpenFile;
-    defer f.close();
-    const file_size = f.getEndPos() catch return error.couldNotGetFileSize;
-    const max_bytes: usize = @intCast(file_size);
-    const c = f.readToEndAlloc(alloc, max_bytes) catch return error.couldNotReadFile;
+// Regular files are mapped read only and tokens slice straight into the mapping,
+// pipes and stdin (path "-") go through the old read path
+pub fn init(alloc: Allocator, path: []const u8, useMmap: bool) LexerCreationError!@This() {
+    var abspath: []const u8 = undefined;
+    var f: std.fs.File = undefined;
+
+    if (std.mem.eql(u8, path, "-")) {
+        abspath = alloc.dupe(u8, "stdin") catch return error.couldNotGetAbsolutePath;
+        f = std.io.getStdIn();
+    } else {
+        abspath = std.fs.realpathAlloc(alloc, path) catch return error.couldNotGetAbsolutePath;
+        f = std.fs.openFileAbsolute(abspath, .{ .mode = .read_only }) catch return error.couldNotOpenFile;
+    }
+    defer if (!std.mem.eql(u8, path, "-")) f.close();
+
+    const stat = f.stat() catch return error.couldNotGetFileSize;
+
+    var mapped: ?[]align(std.mem.page_size) const u8 = null;
+    var c: []const u8 = undefined;
+
+    if (useMmap and stat.kind == .file and stat.size > 0) {
+        const size: usize = @intCast(stat.size);
+        const m = std.posix.mmap(null, size, std.posix.PROT.READ, .{ .TYPE = .PRIVATE }, f.handle, 0) catch return error.couldNotReadFile;
+        std.posix.madvise(m.ptr, m.len, std.posix.MADV.SEQUENTIAL) catch {};
+        mapped = m;
+        c = m;
+    } else {
+        const max_bytes: usize = if (stat.kind == .file) @intCast(stat.size) else std.math.maxInt(usize);
+        c = f.readToEndAlloc(alloc, max_bytes) catch return error.couldNotReadFile;
+    }
 
-    var l = @This(){
+    const l = @This(){
         .content = c,
+        .mapped = mapped,
         .absPath = abspath,
         .path = path,
         .alloc = alloc,
     };
 
-    l.prevLoc.path = path;
-    l.prevLoc.content = c;
-    l.currentLoc.path = path;
-    l.currentLoc.content = c;
-
     return l;
 }
 
-pub fn deinit(self: @This()) void {
-    self.alloc.free(self.content);
+pub fn deinit(self: *@This()) void {
+    self.tokens.deinit(self.alloc);
+    self.idens.deinit(self.alloc);
+    self.lineStarts.deinit(self.alloc);
+    if (self.mapped) |m|
+        std.posix.munmap(m)
+    else
+        self.alloc.free(self.content);
     self.alloc.free(self.absPath);
 }
 
-pub fn lex(alloc: Allocator, arguments: Arguments) ?@This() {
-    const lexer = @This().init(alloc, arguments.path) catch |err| {
+pub fn lex(alloc: Allocator, path: []const u8, useMmap: bool) ?@This() {
+    const lexer = @This().init(alloc, path, useMmap) catch |err| {
         switch (err) {
-            error.couldNotOpenFile => Logger.log.err("Could not open file: {s}\n", .{arguments.path}),
-            error.couldNotReadFile => Logger.log.err("Could not read file: {s}]n", .{arguments.path}),
-            error.couldNotGetFileSize => Logger.log.err("Could not get file ({s}) size\n", .{arguments.path}),
-            error.couldNotGetAbsolutePath => Logger.log.err("Could not get absolute path of file ({s})\n", .{arguments.path}),
+            error.couldNotOpenFile => Logger.log.err("Could not open file: {s}\n", .{path}),
+            error.couldNotReadFile => Logger.log.err("Could not read file: {s}]n", .{path}),
+            error.couldNotGetFileSize => Logger.log.err("Could not get file ({s}) size\n", .{path}),
+            error.couldNotGetAbsolutePath => Logger.log.err("Could not get absolute path of file ({s})\n", .{path}),
         }
         return null;
     };
@@ -1,5 +1,19 @@
-path: []const u8,
-content: []const u8,
-row: u64,
-col: u64,
-i: u64,
+const Lexer = @import("Lexer.zig");
+
+// Only the offset is kept, row and column are resolved when a diagnostic is printed
+lexer: *Lexer,
+i: u32,
+
+pub const Position = struct {
+    row: u64,
+    col: u64,
+    line: []const u8,
+};
+
+pub fn path(self: @This()) []const u8 {
+    return self.lexer.path;
+}
+
+pub fn position(self: @This()) Position {
+    return self.lexer.position(self.i);
+}
@@ -2,13 +2,12 @@ const std = @import("std");
 const assert = std.debug.assert;
 const Allocator = std.mem.Allocator;
 
-const Util = @import("../Util.zig");
-
 const Lexer = @import("Lexer.zig");
+const CharClass = Lexer.CharClass;
 const Location = Lexer.Location;
 const Token = Lexer.Token;
 
-pub const TokenType = enum {
+pub const TokenType = enum(u8) {
     openParen,
     closeParen,
     openBrace,
@@ -24,10 +23,52 @@ pub const TokenType = enum {
     mut,
     EOF,
 
+    const Keyword = struct {
+        const list = [_]struct { []const u8, TokenType }{
+            .{ "mut", .mut },
+            .{ "let", .let },
+            .{ "return", .ret },
+            .{ "fn", .func },
+        };
+
+        const size = 8;
+
+        fn hash(str: []const u8, seed: usize) usize {
+            return (str.len *% seed +% @as(usize, str[0]) *% 31 +% str[str.len - 1]) & (size - 1);
+        }
+
+        // Smallest seed that puts every keyword in its own slot
+        const seed: usize = blk: {
+            for (1..1024) |s| {
+                var used = [_]bool{false} ** size;
+                const collision = for (list) |k| {
+                    const h = hash(k[0], s);
+                    if (used[h]) break true;
+                    used[h] = true;
+                } else false;
+
+                if (!collision) break :blk s;
+            }
+            @compileError("No perfect hash seed for the keywords");
+        };
+
+        const slots: [size]?usize = blk: {
+            var result = [_]?usize{null} ** size;
+            for (list, 0..) |k, i| result[hash(k[0], seed)] = i;
+            break :blk result;
+        };
+
+        fn get(str: []const u8) ?TokenType {
+            const i = slots[hash(str, seed)] orelse return null;
+            if (!std.mem.eql(u8, list[i][0], str)) return null;
+            return list[i][1];
+        }
+    };
+
     pub fn isSymbol(str: []const u8) bool {
         assert(str.len > 0);
         for (str) |c| {
-            if (!Util.listContains(u8, &Lexer.symbols, c)) return false;
+            if (CharClass.get(c) != .symbol) return false;
         }
 
         return true;
@@ -70,52 +111,46 @@ pub const TokenType = enum {
                 'a'...'z', 'A'...'Z' => return TokenType.iden,
                 else => return TokenType.symbol,
             }
-        } else if (std.mem.eql(u8, str, "mut")) {
-            return TokenType.mut;
-        } else if (std.mem.eql(u8, str, "let")) {
-            return TokenType.let;
-        } else if (std.mem.eql(u8, str, "return")) {
-            return TokenType.ret;
-        } else if (std.mem.eql(u8, str, "fn")) {
-            return TokenType.func;
-        } else if (isSymbol(str)) {
-            return TokenType.symbol;
-        } else if (isIden(str)) {
-            return TokenType.iden;
-        } else if (isNumber(str)) {
-            return TokenType.numberLiteral;
-        } else {
-            return TokenType.any;
         }
+
+        if (Keyword.get(str)) |k| return k;
+
+        // One walk instead of isSymbol, isIden and isNumber each rescanning
+        var symbol = true;
+        var number = true;
+        var iden = !std.ascii.isDigit(str[0]);
+        for (str) |c| {
+            const digit = std.ascii.isDigit(c);
+            symbol = symbol and CharClass.get(c) == .symbol;
+            number = number and digit;
+            iden = iden and (digit or std.ascii.isAlphabetic(c) or c == '_');
+        }
+
+        if (symbol) return TokenType.symbol;
+        if (iden) return TokenType.iden;
+        if (number) return TokenType.numberLiteral;
+        return TokenType.any;
     }
 };
 
-path: []const u8,
-absPath: []const u8,
-str: []const u8,
 type: TokenType,
+str: []const u8,
+// Dense intern id, only meaningful for .iden
+id: u32 = 0,
 loc: Location,
 
-pub fn init(path: []const u8, absPath: []const u8, str: []const u8, loc: Location) Token {
-    return Token{
-        .path = path,
-        .absPath = absPath,
-        .type = TokenType.get(str),
-        .str = str,
-        .loc = loc,
-    };
-}
-
 pub fn toString(self: @This(), alloc: Allocator, cont: *std.ArrayList(u8)) std.mem.Allocator.Error!void {
-    try cont.appendSlice(self.path);
+    const pos = self.loc.position();
+
+    try cont.appendSlice(self.loc.path());
     try cont.append(':');
 
-    const row = try std.fmt.allocPrint(alloc, "{}", .{self.loc.row});
+    const row = try std.fmt.allocPrint(alloc, "{}", .{pos.row});
 
     try cont.appendSlice(row);
     try cont.append(':');
 
-    const col = try std.fmt.allocPrint(alloc, "{}", .{self.loc.col});
+    const col = try std.fmt.allocPrint(alloc, "{}", .{pos.col});
 
     try cont.appendSlice(col);
     try cont.append(' ');
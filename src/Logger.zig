@@ -18,32 +18,10 @@ pub const logLocation = struct {
         l(.debug, location, format, args);
     }
 
-    fn printPlace(location: Lexer.Location, writer: std.io.BufferedWriter(4096, std.fs.File.Writer).Writer) void {
-        var beg = location.i;
-
-        while (beg > 1 and location.content[beg - 1] != '\n') : (beg -= 1) {}
-        if (beg > 0)
-            beg -= 1;
-
-        var end = location.i;
-
-        while (end < location.content.len and location.content[end + 1] != '\n') : (end += 1) {}
-        end += 1;
-
-        var pointer = std.BoundedArray(u8, 10 * 1024).init(0) catch unreachable;
-
-        for (0..location.col - 1) |_| {
-            pointer.append(' ') catch {
-                log.err("Line is larger than {} caracters", .{10 * 1024});
-                return;
-            };
-        }
-        pointer.append('^') catch {
-            log.err("Line is larger than {} caracters", .{10 * 1024});
-            return;
-        };
-
-        writer.print("{s}\n{s}\n", .{ location.content[beg..end], pointer.buffer }) catch return;
+    fn printPlace(pos: Lexer.Location.Position, writer: std.io.BufferedWriter(4096, std.fs.File.Writer).Writer) void {
+        writer.print("{s}\n", .{pos.line}) catch return;
+        writer.writeByteNTimes(' ', pos.col -| 1) catch return;
+        writer.writeAll("^\n") catch return;
     }
 
     fn l(comptime message_level: std.log.Level, location: Lexer.Location, comptime format: []const u8, args: anytype) void {
@@ -62,9 +40,10 @@ pub const logLocation = struct {
         std.debug.lockStdErr();
         defer std.debug.unlockStdErr();
         nosuspend {
-            writer.print("{s}:{}:{} ", .{ location.path, location.row, location.col }) catch return;
-            writer.print(level_txt ++ ": " ++ format, args) catch return;
-            printPlace(location, writer);
+            const pos = location.position();
+            writer.print("{s}:{}:{} ", .{ location.path(), pos.row, pos.col }) catch return;
+            writer.print(level_txt ++ ": " ++ format ++ "\n", args) catch return;
+            printPlace(pos, writer);
             bw.flush() catch return;
         }
     }
@@ -0,0 +1,145 @@
+const std = @import("std");
+const builtin = @import("builtin");
+
+const Arguments = @import("ParseArgs.zig").Arguments;
+
+const tb = @import("libs/tb/tb.zig");
+const X64 = tb.FeatureSetX64;
+
+// Instruction set extensions codegen may use, one set for every function of a
+// compile. -march=native asks CPUID, -march=baseline is plain x86-64 and a
+// comma separated list adds to the baseline
+const Feature = struct {
+    name: []const u8,
+    bit: X64,
+};
+
+const features = [_]Feature{
+    .{ .name = "sse2", .bit = .SSE2 },
+    .{ .name = "sse3", .bit = .SSE3 },
+    .{ .name = "sse4.1", .bit = .SSE41 },
+    .{ .name = "sse4.2", .bit = .SSE42 },
+    .{ .name = "popcnt", .bit = .POPCNT },
+    .{ .name = "lzcnt", .bit = .LZCNT },
+    .{ .name = "clmul", .bit = .CLMUL },
+    .{ .name = "f16c", .bit = .F16C },
+    .{ .name = "bmi1", .bit = .BMI1 },
+    .{ .name = "bmi2", .bit = .BMI2 },
+    .{ .name = "avx", .bit = .AVX },
+    .{ .name = "avx2", .bit = .AVX2 },
+};
+
+fn has(bit: X64) u32 {
+    return @intCast(@intFromEnum(bit));
+}
+
+// Every x86-64 has SSE2
+pub fn baseline() tb.FeatureSet {
+    return .{ .gen = 0, .x64 = has(.SSE2) };
+}
+
+// CPUID only exists on x86, anywhere else there is nothing to detect
+pub fn native() tb.FeatureSet {
+    return if (comptime builtin.cpu.arch == .x86_64) detect() else baseline();
+}
+
+fn detect() tb.FeatureSet {
+    var set = baseline();
+    const maxLeaf = cpuid(0, 0)[0];
+    const leaf1 = cpuid(1, 0);
+    const ecx = leaf1[2];
+    if (ecx & (1 << 0) != 0) set.x64 |= has(.SSE3);
+    if (ecx & (1 << 1) != 0) set.x64 |= has(.CLMUL);
+    if (ecx & (1 << 19) != 0) set.x64 |= has(.SSE41);
+    if (ecx & (1 << 20) != 0) set.x64 |= has(.SSE42);
+    if (ecx & (1 << 23) != 0) set.x64 |= has(.POPCNT);
+    if (ecx & (1 << 29) != 0) set.x64 |= has(.F16C);
+
+    // AVX also needs the OS to save the ymm registers
+    const avx = ecx & (1 << 28) != 0 and ecx & (1 << 27) != 0 and xgetbv() & 0b110 == 0b110;
+    if (avx) set.x64 |= has(.AVX);
+
+    if (maxLeaf >= 7) {
+        const ebx = cpuid(7, 0)[1];
+        if (ebx & (1 << 3) != 0) set.x64 |= has(.BMI1);
+        if (ebx & (1 << 8) != 0) set.x64 |= has(.BMI2);
+        if (avx and ebx & (1 << 5) != 0) set.x64 |= has(.AVX2);
+    }
+
+    if (cpuid(0x8000_0000, 0)[0] >= 0x8000_0001) {
+        if (cpuid(0x8000_0001, 0)[2] & (1 << 5) != 0) set.x64 |= has(.LZCNT);
+    }
+
+    return set;
+}
+
+// "native", "baseline" or a list like "popcnt,bmi1,bmi2"
+pub fn parse(spec: []const u8) ?tb.FeatureSet {
+    if (std.mem.eql(u8, spec, "native")) return native();
+    if (std.mem.eql(u8, spec, "baseline")) return baseline();
+
+    var set = baseline();
+    var names = std.mem.tokenizeScalar(u8, spec, ',');
+    while (names.next()) |name| {
+        for (features) |f| {
+            if (std.mem.eql(u8, f.name, name)) {
+                set.x64 |= has(f.bit);
+                break;
+            }
+        } else return null;
+    }
+
+    return set;
+}
+
+// Native when the code runs in this process, baseline when it is written out
+pub fn forArguments(arguments: Arguments) tb.FeatureSet {
+    if (arguments.march) |set| return set;
+    return if (arguments.run or arguments.simulation) native() else baseline();
+}
+
+fn formatSet(set: tb.FeatureSet, comptime _: []const u8, _: std.fmt.FormatOptions, writer: anytype) !void {
+    var first = true;
+    for (features) |f| {
+        if (set.x64 & has(f.bit) == 0) continue;
+        if (!first) try writer.writeByte(',');
+        try writer.writeAll(f.name);
+        first = false;
+    }
+}
+
+pub fn fmt(set: tb.FeatureSet) std.fmt.Formatter(formatSet) {
+    return .{ .data = set };
+}
+
+fn cpuid(leaf: u32, sub: u32) [4]u32 {
+    var eax: u32 = undefined;
+    var ebx: u32 = undefined;
+    var ecx: u32 = undefined;
+    var edx: u32 = undefined;
+    asm volatile ("cpuid"
+        : [eax] "={eax}" (eax),
+          [ebx] "={ebx}" (ebx),
+          [ecx] "={ecx}" (ecx),
+          [edx] "={edx}" (edx),
+        : [leaf] "{eax}" (leaf),
+          [sub] "{ecx}" (sub),
+    );
+    return .{ eax, ebx, ecx, edx };
+}
+
+fn xgetbv() u32 {
+    var eax: u32 = undefined;
+    asm volatile ("xgetbv"
+        : [eax] "={eax}" (eax),
+        : [xcr] "{ecx}" (@as(u32, 0)),
+        : "edx"
+    );
+    return eax;
+}
+
+test "parse" {
+    try std.testing.expectEqual(baseline().x64, parse("baseline").?.x64);
+    try std.testing.expectEqual(has(.SSE2) | has(.POPCNT) | has(.BMI2), parse("popcnt,bmi2").?.x64);
+    try std.testing.expect(parse("popcnt,avx512") == null);
+}
@@ -1,6 +1,18 @@
 const std = @import("std");
 const Logger = @import("Logger.zig");
 const util = @import("Util.zig");
+const March = @import("March.zig");
+const FeatureSet = @import("libs/tb/tb.zig").FeatureSet;
+
+// What integer arithmetic does when the result does not fit its type
+pub const Overflow = enum {
+    // Two's complement wrap around, the default
+    wrap,
+    // Checked, the process traps
+    safe,
+    // Assumed to never happen, TB optimizes on it
+    fast,
+};
 
 pub const Arguments = struct {
     build: bool = false,
@@ -10,11 +22,37 @@ pub const Arguments = struct {
     lex: bool = false,
     parse: bool = false,
     ir: bool = false,
+    assembly: bool = false,
+    // asm prints the size table as JSON instead of the listing
+    json: bool = false,
     silence: bool = false,
     bench: bool = false,
-    path: []const u8,
+    mmap: bool = true,
+    cache: bool = true,
+    // 0 builds the graph as is, 1 adds builder peepholes, 2 runs tb_opt too
+    optimize: u2 = 0,
+    overflow: Overflow = .wrap,
+    // Bytes mapped at a time for JITed code, another chunk is mapped when it fills up
+    jitHeap: usize = 4 * 1024 * 1024,
+    // Null picks native for the JIT and baseline for everything written out
+    march: ?FeatureSet = null,
+    // run starts main unoptimized and rebuilds it at -O2 after tierUp calls
+    tiered: bool = false,
+    tierUp: u64 = 100,
+    // serve listens on the socket, client sends forward to it repeat times
+    serve: bool = false,
+    client: bool = false,
+    socket: []const u8 = "/tmp/yot.sock",
+    repeat: u32 = 1,
+    forward: []const []const u8 = &.{},
+    // Files and directories in the order they were given
+    paths: []const []const u8,
 };
 
+// Process arguments live for the whole run, so they are kept here instead of copied
+var argStorage = std.BoundedArray([]const u8, 1024).init(0) catch unreachable;
+var pathStorage = std.BoundedArray([]const u8, 1024).init(0) catch unreachable;
+
 const ArgumentsError = error{
     noSubcommandProvided,
     noFilePathProvided,
@@ -26,20 +64,25 @@ const ArgError = util.ErrorPayLoad(ArgumentsError, ?[]const u8);
 const ArgumentResult = util.Result(Arguments, ArgError);
 
 pub fn getArguments() ?Arguments {
-    var args = std.BoundedArray([]const u8, 1024).init(0) catch unreachable;
-
     var argsIterator = std.process.args();
 
     _ = argsIterator.skip();
 
     while (argsIterator.next()) |arg| {
-        args.append(arg) catch {
+        argStorage.append(arg) catch {
             Logger.log.err("Out of space, too many args, max = 1024. Change soruce code", .{});
             return null;
         };
     }
 
-    const a: ArgumentResult = parseArguments(args.constSlice());
+    return parse(argStorage.constSlice());
+}
+
+// Also what serve runs on the arguments of every request
+pub fn parse(arguments: []const []const u8) ?Arguments {
+    pathStorage.resize(0) catch unreachable;
+
+    const a: ArgumentResult = parseArguments(arguments);
     switch (a) {
         .err => |err| {
             switch (err.err) {
@@ -57,25 +100,45 @@ pub fn getArguments() ?Arguments {
     return a.ok;
 }
 
-fn parseArguments(args: []const []const u8) ArgumentResult {
-    if (args.len == 0) {
+fn parseArguments(arguments: []const []const u8) ArgumentResult {
+    if (arguments.len == 0) {
         return ArgumentResult.Err(ArgError.init(error.noSubcommandProvided, null));
-    } else if (args.len == 1) {
-        return ArgumentResult.Err(ArgError.init(error.noFilePathProvided, null));
     }
 
-    var a = Arguments{ .path = args[1] };
-
-    parseSubcommand(args[0], &a) catch |err|
-        return ArgumentResult.Err(ArgError.init(err, args[0]));
-
-    const arguments = args[2..];
+    var a = Arguments{ .paths = &.{} };
+
+    // Flags before the subcommand are for the client, the rest goes to the server as is
+    if (std.mem.eql(u8, arguments[0], "client")) {
+        a.client = true;
+        var i: usize = 1;
+        while (i < arguments.len and arguments[i].len > 1 and arguments[i][0] == '-') : (i += 1) {
+            parseArgument(arguments[i], &a) catch |err|
+                return ArgumentResult.Err(ArgError.init(err, arguments[i]));
+        }
+        if (i == arguments.len)
+            return ArgumentResult.Err(ArgError.init(error.noSubcommandProvided, null));
+
+        a.forward = arguments[i..];
+        return ArgumentResult.Ok(a);
+    }
 
-    for (arguments) |arg| {
-        parseArgument(arg, &a) catch |err|
-            return ArgumentResult.Err(ArgError.init(err, arg));
+    parseSubcommand(arguments[0], &a) catch |err|
+        return ArgumentResult.Err(ArgError.init(err, arguments[0]));
+
+    // Anything that is not a flag is a source, "-" is stdin
+    for (arguments[1..]) |arg| {
+        if (arg.len > 1 and arg[0] == '-') {
+            parseArgument(arg, &a) catch |err|
+                return ArgumentResult.Err(ArgError.init(err, arg));
+        } else {
+            pathStorage.append(arg) catch return ArgumentResult.Err(ArgError.init(error.unknownArgument, arg));
+        }
     }
 
+    if (pathStorage.len == 0 and !a.serve)
+        return ArgumentResult.Err(ArgError.init(error.noFilePathProvided, null));
+
+    a.paths = pathStorage.constSlice();
     return ArgumentResult.Ok(a);
 }
 
@@ -92,6 +155,10 @@ fn parseSubcommand(subcommand: []const u8, args: *Arguments) !void {
         args.parse = true;
     } else if (std.mem.eql(u8, subcommand, "ir")) {
         args.ir = true;
+    } else if (std.mem.eql(u8, subcommand, "asm")) {
+        args.assembly = true;
+    } else if (std.mem.eql(u8, subcommand, "serve")) {
+        args.serve = true;
     } else {
         args.build = true;
         return error.unknownSubcommand;
@@ -105,7 +172,54 @@ fn parseArgument(arg: []const u8, args: *Arguments) !void {
         args.silence = true;
     } else if (std.mem.eql(u8, arg, "-stdout")) {
         args.stdout = true;
+    } else if (std.mem.eql(u8, arg, "-no-mmap")) {
+        args.mmap = false;
+    } else if (std.mem.eql(u8, arg, "-no-cache")) {
+        args.cache = false;
+    } else if (std.mem.eql(u8, arg, "-json")) {
+        args.json = true;
+    } else if (std.mem.eql(u8, arg, "-safe")) {
+        args.overflow = .safe;
+    } else if (std.mem.eql(u8, arg, "-fast")) {
+        args.overflow = .fast;
+    } else if (std.mem.eql(u8, arg, "-O0")) {
+        args.optimize = 0;
+    } else if (std.mem.eql(u8, arg, "-O1")) {
+        args.optimize = 1;
+    } else if (std.mem.eql(u8, arg, "-O2")) {
+        args.optimize = 2;
+    } else if (std.mem.startsWith(u8, arg, "-socket=")) {
+        args.socket = arg["-socket=".len..];
+    } else if (std.mem.startsWith(u8, arg, "-repeat=")) {
+        args.repeat = std.fmt.parseInt(u32, arg["-repeat=".len..], 10) catch return error.unknownArgument;
+        if (args.repeat == 0) return error.unknownArgument;
+    } else if (std.mem.startsWith(u8, arg, "-march=")) {
+        args.march = March.parse(arg["-march=".len..]) orelse return error.unknownArgument;
+    } else if (std.mem.eql(u8, arg, "-tiered")) {
+        args.tiered = true;
+    } else if (std.mem.startsWith(u8, arg, "-tier-up=")) {
+        args.tierUp = std.fmt.parseInt(u64, arg["-tier-up=".len..], 10) catch return error.unknownArgument;
+        if (args.tierUp == 0) return error.unknownArgument;
+    } else if (std.mem.startsWith(u8, arg, "-jit-heap=")) {
+        args.jitHeap = parseSize(arg["-jit-heap=".len..]) orelse return error.unknownArgument;
     } else {
         return error.unknownArgument;
     }
 }
+
+// Bytes with an optional k, m or g suffix
+fn parseSize(s: []const u8) ?usize {
+    if (s.len == 0) return null;
+
+    const shift: u6 = switch (std.ascii.toLower(s[s.len - 1])) {
+        'k' => 10,
+        'm' => 20,
+        'g' => 30,
+        else => 0,
+    };
+    const digits = if (shift == 0) s else s[0 .. s.len - 1];
+    const n = std.fmt.parseInt(usize, digits, 10) catch return null;
+    if (n == 0) return null;
+
+    return std.math.shlExact(usize, n, shift) catch null;
+}
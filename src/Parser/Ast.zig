@@ -0,0 +1,110 @@
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+
+const Lexer = @import("../Lexer/Lexer.zig");
+const Location = Lexer.Location;
+
+const Parser = @import("./Parser.zig");
+const Expression = Parser.Expression;
+const Primitive = Parser.Primitive;
+
+pub const Tag = enum(u8) {
+    bin,
+    una,
+    leaf,
+    paren,
+    variable,
+    // Result of constant folding, the value is split over lhs (low) and rhs (high)
+    constant,
+};
+
+// Children are always added before their parent, so the nodes of an
+// expression end up in postfix order
+pub const Node = struct {
+    tag: Tag,
+    // Index in the lexer token buffer: operator, literal or identifier
+    token: u32,
+    // bin: left, una/paren: operand, variable: intern id, constant: low bits
+    lhs: u32 = 0,
+    // bin: right, variable: slot of its let in the function, constant: high bits
+    rhs: u32 = 0,
+    // Resolved by the type check, undefined before it
+    ty: Primitive = undefined,
+};
+
+nodes: std.MultiArrayList(Node) = .{},
+lexer: *Lexer,
+alloc: Allocator,
+
+pub fn init(alloc: Allocator, lexer: *Lexer) @This() {
+    return @This(){
+        .alloc = alloc,
+        .lexer = lexer,
+    };
+}
+
+// One buffer per column, teardown does not walk the tree
+pub fn deinit(self: *@This()) void {
+    self.nodes.deinit(self.alloc);
+}
+
+pub fn add(self: *@This(), node: Node) Allocator.Error!Expression {
+    const i: u32 = @intCast(self.nodes.len);
+    try self.nodes.append(self.alloc, node);
+    return @enumFromInt(i);
+}
+
+pub fn get(self: *const @This(), e: Expression) Node {
+    return self.nodes.get(@intFromEnum(e));
+}
+
+pub fn tag(self: *const @This(), e: Expression) Tag {
+    return self.nodes.items(.tag)[@intFromEnum(e)];
+}
+
+pub fn lhs(self: *const @This(), e: Expression) Expression {
+    return @enumFromInt(self.nodes.items(.lhs)[@intFromEnum(e)]);
+}
+
+pub fn rhs(self: *const @This(), e: Expression) Expression {
+    return @enumFromInt(self.nodes.items(.rhs)[@intFromEnum(e)]);
+}
+
+pub fn typeOf(self: *const @This(), e: Expression) Primitive {
+    return self.nodes.items(.ty)[@intFromEnum(e)];
+}
+
+pub fn setType(self: *@This(), e: Expression, t: Primitive) void {
+    self.nodes.items(.ty)[@intFromEnum(e)] = t;
+}
+
+// Dense index of the let a variable refers to, resolved when lowering to IR
+pub fn slot(self: *const @This(), e: Expression) u32 {
+    return self.nodes.items(.rhs)[@intFromEnum(e)];
+}
+
+pub fn setSlot(self: *@This(), e: Expression, s: u32) void {
+    self.nodes.items(.rhs)[@intFromEnum(e)] = s;
+}
+
+pub fn loc(self: *const @This(), e: Expression) Location {
+    return self.lexer.token(self.nodes.items(.token)[@intFromEnum(e)]).loc;
+}
+
+pub fn value(self: *const @This(), e: Expression) u64 {
+    const i = @intFromEnum(e);
+    return @as(u64, self.nodes.items(.rhs)[i]) << 32 | self.nodes.items(.lhs)[i];
+}
+
+// Replaces the node in place, its children stay in the pool but are no longer reachable
+pub fn setConstant(self: *@This(), e: Expression, v: u64) void {
+    const i = @intFromEnum(e);
+    self.nodes.items(.tag)[i] = .constant;
+    self.nodes.items(.lhs)[i] = @truncate(v);
+    self.nodes.items(.rhs)[i] = @truncate(v >> 32);
+}
+
+// Source text of the node's token
+pub fn str(self: *const @This(), e: Expression) []const u8 {
+    return self.lexer.str(self.nodes.items(.token)[@intFromEnum(e)]);
+}
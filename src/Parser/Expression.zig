@@ -1,8 +1,8 @@
 const std = @import("std");
-const Logger = @import("../Logger.zig");
 
 const Parser = @import("Parser.zig");
 const UnexpectedToken = Parser.UnexpectedToken;
+const Ast = Parser.Ast;
 
 const Lexer = @import("../Lexer/Lexer.zig");
 const Token = Lexer.Token;
@@ -14,6 +14,9 @@ const IR = @import("../IR/IR.zig");
 const tb = @import("../libs/tb/tb.zig");
 
 const tbHelper = @import("../TBHelper.zig");
+const StrengthReduce = @import("../StrengthReduce.zig");
+const Checked = @import("../Checked.zig");
+const Overflow = @import("../ParseArgs.zig").Overflow;
 const getType = tbHelper.getType;
 
 pub const Operand = std.StaticStringMap(u8).initComptime(.{
@@ -25,7 +28,7 @@ pub const Operand = std.StaticStringMap(u8).initComptime(.{
     .{ "-", 2 },
 });
 
-pub const Binary = std.StaticStringMap(*const fn (g: tb.GraphBuilder, left: *tb.Node, right: *tb.Node, usigned: bool) *tb.Node).initComptime(.{
+pub const Binary = std.StaticStringMap(*const fn (g: tb.GraphBuilder, left: *tb.Node, right: *tb.Node, usigned: bool, overflow: Overflow) *tb.Node).initComptime(.{
     .{ "^", &BinaryFunction.power },
     .{ "%", &BinaryFunction.mod },
     .{ "*", &BinaryFunction.multiply },
@@ -34,38 +37,55 @@ pub const Binary = std.StaticStringMap(*const fn (g: tb.GraphBuilder, left: *tb.
     .{ "-", &BinaryFunction.minus },
 });
 
+// -fast promises TB the operation never wraps for the signedness of the type
+fn noWrap(unsigned: bool) tb.ArithmeticBehavior {
+    return if (unsigned) tb.ArithmeticBehavior.NUW else tb.ArithmeticBehavior.NSW;
+}
+
 // For overflow, underflow execption and division and mod that requiere different node types.
 const BinaryFunction = struct {
-    pub fn minus(g: tb.GraphBuilder, left: *tb.Node, right: *tb.Node, unsigned: bool) *tb.Node {
-        _ = unsigned;
-        return g.binopInt(tb.NodeType.SUB, left, right, tb.ArithmeticBehavior.NONE);
+    pub fn minus(g: tb.GraphBuilder, left: *tb.Node, right: *tb.Node, unsigned: bool, overflow: Overflow) *tb.Node {
+        return switch (overflow) {
+            .wrap => g.binopInt(tb.NodeType.SUB, left, right, tb.ArithmeticBehavior.NONE),
+            .fast => g.binopInt(tb.NodeType.SUB, left, right, noWrap(unsigned)),
+            .safe => Checked.sub(g, left, right, !unsigned),
+        };
     }
-    pub fn plus(g: tb.GraphBuilder, left: *tb.Node, right: *tb.Node, unsigned: bool) *tb.Node {
-        _ = unsigned;
-        return g.binopInt(tb.NodeType.ADD, left, right, tb.ArithmeticBehavior.NONE);
+    pub fn plus(g: tb.GraphBuilder, left: *tb.Node, right: *tb.Node, unsigned: bool, overflow: Overflow) *tb.Node {
+        return switch (overflow) {
+            .wrap => g.binopInt(tb.NodeType.ADD, left, right, tb.ArithmeticBehavior.NONE),
+            .fast => g.binopInt(tb.NodeType.ADD, left, right, noWrap(unsigned)),
+            .safe => Checked.add(g, left, right, !unsigned),
+        };
     }
-    pub fn multiply(g: tb.GraphBuilder, left: *tb.Node, right: *tb.Node, unsigned: bool) *tb.Node {
-        _ = unsigned;
-        return g.binopInt(tb.NodeType.MUL, left, right, tb.ArithmeticBehavior.NONE);
+    pub fn multiply(g: tb.GraphBuilder, left: *tb.Node, right: *tb.Node, unsigned: bool, overflow: Overflow) *tb.Node {
+        return switch (overflow) {
+            .wrap => g.binopInt(tb.NodeType.MUL, left, right, tb.ArithmeticBehavior.NONE),
+            .fast => g.binopInt(tb.NodeType.MUL, left, right, noWrap(unsigned)),
+            .safe => Checked.mul(g, left, right, !unsigned),
+        };
     }
-    pub fn division(g: tb.GraphBuilder, left: *tb.Node, right: *tb.Node, unsigned: bool) *tb.Node {
-        _ = unsigned;
-        return g.binopInt(tb.NodeType.UDIV, left, right, tb.ArithmeticBehavior.NONE);
+    // Division can not overflow but minInt / -1, which the instruction already traps on
+    pub fn division(g: tb.GraphBuilder, left: *tb.Node, right: *tb.Node, unsigned: bool, overflow: Overflow) *tb.Node {
+        _ = overflow;
+        return g.binopInt(if (unsigned) tb.NodeType.UDIV else tb.NodeType.SDIV, left, right, tb.ArithmeticBehavior.NONE);
     }
-    pub fn mod(g: tb.GraphBuilder, left: *tb.Node, right: *tb.Node, unsigned: bool) *tb.Node {
-        _ = unsigned;
-        return g.binopInt(tb.NodeType.UMOD, left, right, tb.ArithmeticBehavior.NONE);
+    pub fn mod(g: tb.GraphBuilder, left: *tb.Node, right: *tb.Node, unsigned: bool, overflow: Overflow) *tb.Node {
+        _ = overflow;
+        return g.binopInt(if (unsigned) tb.NodeType.UMOD else tb.NodeType.SMOD, left, right, tb.ArithmeticBehavior.NONE);
     }
-    pub fn power(g: tb.GraphBuilder, base: *tb.Node, exp: *tb.Node, unsigned: bool) *tb.Node {
-        Logger.log.warn("Power is unstable with optimizer", .{});
-
-        _ = unsigned;
-
-        const condAddr = g.local(1, 1);
-        g.store(0, false, condAddr, exp, 1, false);
-
-        const resultAddr = g.local(1, 1);
-        g.store(0, false, resultAddr, g.uint(base.dt, 1), 1, false);
+    // Square-and-multiply on builder variables, the loop carries them in phis so
+    // nothing touches memory. The exponent is unsigned and runs log2(exp) iterations.
+    // Under -safe the products are checked, but the squaring after the last bit is
+    // never used and may overflow on its own, so it squares 1 instead
+    pub fn power(g: tb.GraphBuilder, base: *tb.Node, exp: *tb.Node, unsigned: bool, overflow: Overflow) *tb.Node {
+        const scope = g.labelGet();
+        const result = g.decl(scope);
+        g.setVar(result, g.uint(base.dt, 1));
+        const square = g.decl(scope);
+        g.setVar(square, base);
+        const n = g.decl(scope);
+        g.setVar(n, exp);
 
         const exit = g.labelMake();
         const header = g.loop();
@@ -74,23 +94,27 @@ const BinaryFunction = struct {
         {
             var paths: [2]*tb.Node = undefined;
 
-            const n = g.load(0, false, exp.dt, condAddr, 1, false);
-            // const zero = g.uint(n.dt, 0);
-            // const cond = g.cmp(tb.NodeType.CMP_NE, n, zero);
-
-            g.@"if"(n, &paths);
+            g.@"if"(g.getVar(n), &paths);
 
             _ = g.labelSet(paths[1]);
             g.br(exit);
             g.labelKill(paths[1]);
 
             _ = g.labelSet(paths[0]);
-            const result = g.load(0, false, exp.dt, resultAddr, 1, false);
-            const newResult = g.binopInt(tb.NodeType.MUL, result, base, tb.ArithmeticBehavior.NONE);
-            g.store(0, false, resultAddr, newResult, 1, false);
-
-            const newValue = g.binopInt(tb.NodeType.SUB, n, g.uint(tb.typeI8(), 1), tb.ArithmeticBehavior.NONE);
-            g.store(0, false, condAddr, newValue, 1, false);
+            const one = g.uint(exp.dt, 1);
+            const bit = g.binopInt(tb.NodeType.AND, g.getVar(n), one, tb.ArithmeticBehavior.NONE);
+            const odd = g.cmp(tb.NodeType.CMP_NE, bit, g.uint(exp.dt, 0));
+            const factor = g.select(odd, g.getVar(square), g.uint(base.dt, 1));
+
+            g.setVar(result, powerMul(g, g.getVar(result), factor, unsigned, overflow));
+            g.setVar(n, g.binopInt(tb.NodeType.SHR, g.getVar(n), one, tb.ArithmeticBehavior.NONE));
+            if (overflow == .safe) {
+                const more = g.cmp(tb.NodeType.CMP_NE, g.getVar(n), g.uint(exp.dt, 0));
+                const s = g.select(more, g.getVar(square), g.uint(base.dt, 1));
+                g.setVar(square, Checked.mul(g, s, s, !unsigned));
+            } else {
+                g.setVar(square, g.binopInt(tb.NodeType.MUL, g.getVar(square), g.getVar(square), tb.ArithmeticBehavior.NONE));
+            }
 
             g.br(loop);
             g.labelKill(paths[0]);
@@ -101,219 +125,338 @@ const BinaryFunction = struct {
 
         _ = g.labelSet(exit);
 
-        const result = g.load(0, false, base.dt, resultAddr, 1, false);
+        return g.getVar(result);
+    }
+
+    // Constant exponents become straight line multiplications. Below chainLimit
+    // the shortest addition chain is used, above it square-and-multiply is unrolled.
+    // Every product is a power of base up to exp, so under -safe all of them are
+    // checked and none traps unless the result itself does not fit
+    pub fn powerConstant(g: tb.GraphBuilder, base: *tb.Node, exp: u64, unsigned: bool, overflow: Overflow) *tb.Node {
+        if (exp == 0) return g.uint(base.dt, 1);
+
+        if (exp < chainLimit) {
+            const chain = shortestChain(@intCast(exp));
+            var nodes: [maxChain]*tb.Node = undefined;
+            nodes[0] = base;
+
+            // Every step adds some earlier element to the previous one
+            for (1..chain.len) |i| {
+                const prev = chain.get(i - 1);
+                const j = std.mem.indexOfScalar(u8, chain.constSlice()[0..i], chain.get(i) - prev).?;
+                nodes[i] = powerMul(g, nodes[i - 1], nodes[j], unsigned, overflow);
+            }
+
+            return nodes[chain.len - 1];
+        }
+
+        var result = base;
+        var bit = 63 - @clz(exp);
+        while (bit > 0) {
+            bit -= 1;
+            result = powerMul(g, result, result, unsigned, overflow);
+            if ((exp >> @intCast(bit)) & 1 == 1)
+                result = powerMul(g, result, base, unsigned, overflow);
+        }
 
         return result;
     }
 };
 
-pub const Unary = std.StaticStringMap(*const fn (g: tb.GraphBuilder, e: *tb.Node, usigned: bool) *tb.Node).initComptime(.{
+// Products of ^, -fast keeps the wrapping of -wrap
+fn powerMul(g: tb.GraphBuilder, a: *tb.Node, b: *tb.Node, unsigned: bool, overflow: Overflow) *tb.Node {
+    if (overflow == .safe) return Checked.mul(g, a, b, !unsigned);
+    return g.binopInt(tb.NodeType.MUL, a, b, tb.ArithmeticBehavior.NONE);
+}
+
+// Star chains, where each element adds to the one before it, are optimal for
+// every exponent below this and none of them needs more than 10 multiplications
+const chainLimit = 128;
+const maxChain = 12;
+const Chain = std.BoundedArray(u8, maxChain);
+
+// Iterative deepening, so the first chain found is the shortest
+fn shortestChain(n: u8) Chain {
+    var depth: usize = 0;
+    while (true) : (depth += 1) {
+        var chain = Chain.init(0) catch unreachable;
+        chain.appendAssumeCapacity(1);
+        if (extendChain(&chain, n, depth)) return chain;
+    }
+}
+
+fn extendChain(chain: *Chain, n: u8, depth: usize) bool {
+    const last = chain.get(chain.len - 1);
+    if (last == n) return true;
+
+    const done = chain.len - 1;
+    if (done == depth) return false;
+    // Doubling every remaining step is the fastest a chain can grow
+    if (@as(u64, last) << @intCast(depth - done) < n) return false;
+
+    var j = chain.len;
+    while (j > 0) {
+        j -= 1;
+        const next = @as(u16, last) + chain.get(j);
+        if (next > n) continue;
+
+        chain.appendAssumeCapacity(@intCast(next));
+        if (extendChain(chain, n, depth)) return true;
+        _ = chain.pop();
+    }
+
+    return false;
+}
+
+pub const Unary = std.StaticStringMap(*const fn (g: tb.GraphBuilder, e: *tb.Node, usigned: bool, overflow: Overflow) *tb.Node).initComptime(.{
     .{ "-", &UnaryFunction.neg },
 });
 
 const UnaryFunction = struct {
-    pub fn neg(g: tb.GraphBuilder, e: *tb.Node, unsigned: bool) *tb.Node {
-        _ = unsigned;
+    pub fn neg(g: tb.GraphBuilder, e: *tb.Node, unsigned: bool, overflow: Overflow) *tb.Node {
+        if (overflow == .safe) return Checked.neg(g, e, !unsigned);
         return g.neg(e);
     }
 };
 
-//https://en.cppreference.com/w/c/language/operator_precedence
-
-pub const Expression = union(enum) {
-    var depth: u64 = 0;
-
-    bin: struct {
-        op: Token,
-        left: *Expression,
-        right: *Expression,
-    },
-    una: struct {
-        op: Token,
-        e: *Expression,
-    },
-    leaf: Token,
-    paren: *Expression,
-    variable: Token,
-
-    fn makeLeaf(alloc: std.mem.Allocator, t: Token) std.mem.Allocator.Error!*@This() {
-        return Util.dupe(alloc, @This(){ .leaf = t });
-    }
+// Float literals are stored as f64 bits, an f32 is rounded from them
+fn floatConstant(g: tb.GraphBuilder, size: u8, bits: u64) *tb.Node {
+    const v: f64 = @bitCast(bits);
+    return if (size == 32) g.float32(@floatCast(v)) else g.float64(v);
+}
+
+// The type check only lets + - * / through for floats, none of them can overflow
+fn floatBinary(g: tb.GraphBuilder, op: u8, left: *tb.Node, right: *tb.Node) *tb.Node {
+    return g.binopFloat(switch (op) {
+        '+' => tb.NodeType.FADD,
+        '-' => tb.NodeType.FSUB,
+        '*' => tb.NodeType.FMUL,
+        '/' => tb.NodeType.FDIV,
+        else => unreachable,
+    }, left, right);
+}
 
-    fn makeVar(alloc: std.mem.Allocator, t: Token) std.mem.Allocator.Error!*@This() {
-        return Util.dupe(alloc, @This(){ .variable = t });
-    }
+//https://en.cppreference.com/w/c/language/operator_precedence
 
-    fn makeParen(alloc: std.mem.Allocator, t: *@This()) std.mem.Allocator.Error!*@This() {
-        return Util.dupe(alloc, @This(){ .paren = t });
-    }
+pub const Expression = enum(u32) {
+    _,
+
+    pub const Pending = union(enum) {
+        bin: struct {
+            token: u32,
+            prec: u8,
+        },
+        una: u32,
+        paren,
+    };
+
+    const Stacks = struct {
+        ast: *Ast,
+        operands: *std.ArrayList(Expression),
+        operators: *std.ArrayList(Pending),
+
+        fn topIs(self: @This(), tag: std.meta.Tag(Pending)) bool {
+            const ops = self.operators.items;
+            return ops.len > 0 and ops[ops.len - 1] == tag;
+        }
 
-    fn makeUnary(alloc: std.mem.Allocator, op: Token, expr: *@This()) std.mem.Allocator.Error!*@This() {
-        return Util.dupe(
-            alloc,
-            @This(){
-                .una = .{
-                    .op = op,
-                    .e = expr,
-                },
-            },
-        );
-    }
+        // Unary operators bind to the term right after them, tighter than any binary
+        fn pushOperand(self: *@This(), e: Expression) std.mem.Allocator.Error!void {
+            var expr = e;
+            while (self.topIs(.una)) {
+                expr = try self.ast.add(.{ .tag = .una, .token = self.operators.pop().una, .lhs = @intFromEnum(expr) });
+            }
+            try self.operands.append(expr);
+        }
 
-    fn makeBinary(alloc: std.mem.Allocator, op: Token, left: *@This(), right: *@This()) std.mem.Allocator.Error!*@This() {
-        switch (left.*) {
-            else => {
-                return Util.dupe(
-                    alloc,
-                    @This(){
-                        .bin = .{
-                            .op = op,
-                            .left = left,
-                            .right = right,
-                        },
-                    },
-                );
-            },
-            .bin => {
-                if (Operand.get(op.str).? >= Operand.get(left.bin.op.str).?) {
-                    return Util.dupe(
-                        alloc,
-                        @This(){
-                            .bin = .{
-                                .op = op,
-                                .left = left,
-                                .right = right,
-                            },
-                        },
-                    );
-                } else {
-                    const leftRight = left.bin.right;
-                    const newExpr = try Util.dupe(
-                        alloc,
-                        @This(){
-                            .bin = .{
-                                .op = op,
-                                .left = leftRight,
-                                .right = right,
-                            },
-                        },
-                    );
-
-                    left.bin.right = newExpr;
-                    return left;
-                }
-            },
+        fn reduce(self: *@This()) std.mem.Allocator.Error!void {
+            const op = self.operators.pop().bin;
+            const right = self.operands.pop();
+            const left = self.operands.pop();
+            try self.operands.append(try self.ast.add(.{
+                .tag = .bin,
+                .token = op.token,
+                .lhs = @intFromEnum(left),
+                .rhs = @intFromEnum(right),
+            }));
         }
-    }
 
-    fn parseTerm(p: *Parser) (std.mem.Allocator.Error || error{UnexpectedToken})!*@This() {
-        var nextToken = p.l.peek();
+        // Reduces every pending binary whose precedence is at least as tight as prec (left associative)
+        fn reduceWhile(self: *@This(), prec: u8) std.mem.Allocator.Error!void {
+            while (self.topIs(.bin)) {
+                if (self.operators.items[self.operators.items.len - 1].bin.prec > prec) break;
+                try self.reduce();
+            }
+        }
+    };
+
+    // Precedence climbing with explicit stacks, linear in the number of tokens and
+    // the nesting depth of parentheses only costs heap, not native stack. The
+    // stacks belong to the parser, once they have grown an expression allocates
+    // nothing but its nodes
+    pub fn parse(p: *Parser) (std.mem.Allocator.Error || error{UnexpectedToken})!@This() {
+        p.operands.clearRetainingCapacity();
+        p.operators.clearRetainingCapacity();
+        var stacks = Stacks{
+            .ast = &p.program.ast,
+            .operands = &p.operands,
+            .operators = &p.operators,
+        };
 
-        if (!try p.expect(nextToken, &[_]Lexer.TokenType{ .openParen, .symbol, .numberLiteral, .iden })) return error.UnexpectedToken;
+        var parens: usize = 0;
+        var expectOperand = true;
 
-        if (nextToken.type == .openParen) {
-            depth += 1;
-            _ = p.l.pop();
+        while (true) {
+            const index = p.l.cursor;
+            const nextToken = p.l.peek();
 
-            const expr = try parse(p);
+            if (expectOperand) {
+                if (!try p.expect(nextToken, &[_]Lexer.TokenType{ .openParen, .symbol, .numberLiteral, .iden })) return error.UnexpectedToken;
+                _ = p.l.pop();
 
-            if (p.l.pop().type != .closeParen) unreachable;
+                switch (nextToken.type) {
+                    .openParen => {
+                        parens += 1;
+                        try stacks.operators.append(.paren);
+                    },
+                    .symbol => {
+                        if (!Unary.has(nextToken.str)) {
+                            try p.unknownOperator(nextToken, .unaryOperator);
+                            return error.UnexpectedToken;
+                        }
+                        try stacks.operators.append(.{ .una = index });
+                    },
+                    .numberLiteral => {
+                        try stacks.pushOperand(try stacks.ast.add(.{ .tag = .leaf, .token = index }));
+                        expectOperand = false;
+                    },
+                    .iden => {
+                        try stacks.pushOperand(try stacks.ast.add(.{ .tag = .variable, .token = index, .lhs = nextToken.id }));
+                        expectOperand = false;
+                    },
+                    else => unreachable,
+                }
+                continue;
+            }
 
-            std.debug.assert(depth != 0);
-            depth -= 1;
+            if (nextToken.type == .semicolon) break;
 
-            return try makeParen(p.alloc, expr);
-        } else if (nextToken.type == .symbol) {
-            const op = p.l.pop();
-            nextToken = p.l.peek();
-            if (nextToken.type == .openParen) {
-                depth += 1;
+            if (nextToken.type == .closeParen) {
+                // Unmatched closing paren belongs to whoever called us
+                if (parens == 0) break;
                 _ = p.l.pop();
+                parens -= 1;
 
-                const expr = try parse(p);
-                if (!try p.expect(p.l.pop(), &[_]Lexer.TokenType{.closeParen})) return error.UnexpectedToken;
-
-                if (depth == 0) unreachable;
-                depth -= 1;
+                try stacks.reduceWhile(std.math.maxInt(u8));
+                const marker = stacks.operators.pop();
+                std.debug.assert(marker == .paren);
 
-                return try makeUnary(p.alloc, op, try makeParen(p.alloc, expr));
-            } else if (nextToken.type == .symbol) {
-                const expr = try parseTerm(p);
-                return try makeUnary(p.alloc, op, expr);
-            } else if (nextToken.type == .numberLiteral) {
-                return try makeUnary(p.alloc, op, try makeLeaf(p.alloc, p.l.pop()));
+                const inner = stacks.operands.pop();
+                try stacks.pushOperand(try stacks.ast.add(.{ .tag = .paren, .token = index, .lhs = @intFromEnum(inner) }));
+                continue;
             }
-        } else if (nextToken.type == .numberLiteral) {
-            return try makeLeaf(p.alloc, p.l.pop());
-        } else if (nextToken.type == .iden) {
-            return try makeVar(p.alloc, p.l.pop());
-        }
-        unreachable;
-    }
 
-    pub fn parse(p: *Parser) (std.mem.Allocator.Error || error{UnexpectedToken})!*@This() {
-        var nextToken = p.l.peek();
-        if (nextToken.type == .semicolon) unreachable;
-
-        var expr = try parseTerm(p);
-        nextToken = p.l.peek();
+            if (!try p.expect(nextToken, &[_]Lexer.TokenType{ .symbol, .closeParen, .semicolon })) return error.UnexpectedToken;
+            const prec = Operand.get(nextToken.str) orelse {
+                try p.unknownOperator(nextToken, .binaryOperator);
+                return error.UnexpectedToken;
+            };
+            _ = p.l.pop();
 
-        while (nextToken.type != .semicolon and nextToken.type != .closeParen) : (nextToken = p.l.peek()) {
-            const op = p.l.pop();
-            if (op.type != .symbol) unreachable;
+            try stacks.reduceWhile(prec);
+            try stacks.operators.append(.{ .bin = .{ .token = index, .prec = prec } });
+            expectOperand = true;
+        }
 
-            const right = try parseTerm(p);
-            expr = try makeBinary(p.alloc, op, expr, right);
+        if (parens != 0) {
+            _ = try p.expect(p.l.peek(), &[_]Lexer.TokenType{.closeParen});
+            return error.UnexpectedToken;
         }
 
-        return expr;
+        try stacks.reduceWhile(std.math.maxInt(u8));
+        std.debug.assert(stacks.operands.items.len == 1 and stacks.operators.items.len == 0);
+
+        return stacks.operands.items[0];
     }
 
-    pub fn codeGen(self: @This(), g: tb.GraphBuilder, scope: *std.StringHashMap(*tb.Node), ty: Parser.Primitive, t: tb.DataType) *tb.Node {
-        return switch (self) {
-            .una => |u| Unary.get(u.op.str).?(g, u.e.codeGen(g, scope, ty, t), true),
-            .paren => |p| return p.codeGen(g, scope, ty, t),
-            .bin => |b| {
-                const left = b.left.codeGen(g, scope, ty, t);
-                const right = b.right.codeGen(g, scope, ty, t);
-                return Binary.get(b.op.str).?(g, left, right, true);
-            },
-            .leaf => |l| {
-                return g.uint(t, std.fmt.parseUnsigned(u64, l.str, 10) catch unreachable);
-            },
-            .variable => |v| {
-                const addr = scope.get(v.str).?;
+    // Types and literal values were resolved by the type check, t is the backend
+    // type of the whole expression
+    pub fn codeGen(self: @This(), ast: *const Ast, g: tb.GraphBuilder, scope: []const IR.Variable.Binding, t: tb.DataType, overflow: Overflow) *tb.Node {
+        const node = ast.get(self);
+        const unsigned = node.ty.type != .signed;
+        if (node.ty.type == .float) switch (node.tag) {
+            // Multiplying keeps the sign of zero, -0.0 stays distinct from 0.0
+            .una => return g.binopFloat(tb.NodeType.FMUL, ast.lhs(self).codeGen(ast, g, scope, t, overflow), floatConstant(g, node.ty.size, @bitCast(@as(f64, -1)))),
+            .bin => return floatBinary(g, ast.str(self)[0], ast.lhs(self).codeGen(ast, g, scope, t, overflow), ast.rhs(self).codeGen(ast, g, scope, t, overflow)),
+            .constant => return floatConstant(g, node.ty.size, ast.value(self)),
+            else => {},
+        };
+
+        return switch (node.tag) {
+            .una => Unary.get(ast.str(self)).?(g, ast.lhs(self).codeGen(ast, g, scope, t, overflow), unsigned, overflow),
+            .paren => ast.lhs(self).codeGen(ast, g, scope, t, overflow),
+            .bin => {
+                const op = ast.str(self)[0];
+                const integer = node.ty.type == .signed or node.ty.type == .unsigned;
+                // Shifts and adds can not tell when a product overflowed
+                const reduce = integer and (op != '*' or overflow != .safe);
+                // Multiplication commutes, a constant on the left is reduced the same way
+                if (reduce and op == '*' and ast.tag(ast.lhs(self)) == .constant) {
+                    const right = ast.rhs(self).codeGen(ast, g, scope, t, overflow);
+                    if (StrengthReduce.lower(g, op, right, ast.value(ast.lhs(self)), node.ty.size, !unsigned)) |n| return n;
+                    return Binary.get(ast.str(self)).?(g, ast.lhs(self).codeGen(ast, g, scope, t, overflow), right, unsigned, overflow);
+                }
 
-                return g.load(0, false, t, addr, ty.size / 8, false);
+                const left = ast.lhs(self).codeGen(ast, g, scope, t, overflow);
+                if (integer and ast.tag(ast.rhs(self)) == .constant) {
+                    const c = ast.value(ast.rhs(self));
+                    if (op == '^') return BinaryFunction.powerConstant(g, left, c, unsigned, overflow);
+                    if (reduce) if (StrengthReduce.lower(g, op, left, c, node.ty.size, !unsigned)) |n| return n;
+                }
+
+                const right = ast.rhs(self).codeGen(ast, g, scope, t, overflow);
+                return Binary.get(ast.str(self)).?(g, left, right, unsigned, overflow);
+            },
+            // Decoded into constants by the type check
+            .leaf => unreachable,
+            .constant => g.uint(t, ast.value(self)),
+            .variable => {
+                const b = scope[ast.slot(self)];
+                const v = switch (b.value) {
+                    .node => |n| n,
+                    .variable => |id| g.getVar(id),
+                };
+
+                return tbHelper.resize(g, v, b.t, node.ty);
             },
         };
     }
 
-    pub fn toString(self: @This(), cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
-        switch (self) {
-            .bin => |b| {
+    pub fn toString(self: @This(), ast: *const Ast, cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
+        switch (ast.tag(self)) {
+            .bin => {
                 try cont.append('(');
-                try b.left.toString(cont, d);
+                try ast.lhs(self).toString(ast, cont, d);
                 try cont.append(' ');
-                try cont.appendSlice(b.op.str);
+                try cont.appendSlice(ast.str(self));
                 try cont.append(' ');
-                try b.right.toString(cont, d);
+                try ast.rhs(self).toString(ast, cont, d);
                 try cont.append(')');
             },
-            .una => |u| {
+            .una => {
                 try cont.append('(');
-                try cont.appendSlice(u.op.str);
-                try u.e.toString(cont, d);
+                try cont.appendSlice(ast.str(self));
+                try ast.lhs(self).toString(ast, cont, d);
                 try cont.append(')');
             },
-            .leaf => |l| {
-                try cont.appendSlice(l.str);
+            .leaf, .variable => {
+                try cont.appendSlice(ast.str(self));
             },
-            .paren => |p| {
-                try p.toString(cont, d);
+            .constant => {
+                try cont.writer().print("{}", .{ast.value(self)});
             },
-            .variable => |v| {
-                try cont.appendSlice(v.str);
+            .paren => {
+                try ast.lhs(self).toString(ast, cont, d);
             },
         }
     }
@@ -7,6 +7,8 @@ const Primitive = Parser.Primitive;
 const UnexpectedToken = Parser.UnexpectedToken;
 const Statement = Parser.Statement;
 const Statements = Parser.Statements;
+const Expression = Parser.Expression;
+const Ast = Parser.Ast;
 
 const Lexer = @import("../Lexer/Lexer.zig");
 const Location = @import("../Lexer/Location.zig");
@@ -20,12 +22,17 @@ const Util = @import("../Util.zig");
 const Result = Util.Result;
 
 name: []const u8,
+id: u32,
 //args: void,
 body: Statements,
 returnType: Primitive,
 loc: Location,
+// Token range of the whole definition, from fn to the closing brace
+firstToken: u32,
+endToken: u32,
 
 pub fn parse(p: *Parser) (std.mem.Allocator.Error || error{UnexpectedToken})!@This() {
+    const firstToken = p.l.cursor;
     const func = p.l.peek();
     assert(func.type == .func);
 
@@ -61,10 +68,13 @@ pub fn parse(p: *Parser) (std.mem.Allocator.Error || error{UnexpectedToken})!@Th
 
     return @This(){
         .name = name.str,
+        .id = name.id,
         // .args = void,
         .returnType = Primitive.getType(ret.str),
         .body = state,
         .loc = funcLoc,
+        .firstToken = firstToken,
+        .endToken = p.l.cursor,
     };
 }
 
@@ -89,18 +99,57 @@ fn parseBody(p: *Parser) std.mem.Allocator.Error!Statements {
     return statements;
 }
 
-pub fn toIR(self: @This(), alloc: std.mem.Allocator, prog: *IR.Program, m: tb.Module) std.mem.Allocator.Error!IR.Function {
-    var f = IR.Function.init(alloc, self, m);
+// Names are resolved once here: every let gets the next dense slot and every
+// variable node points at the slot of the let it reads. Null if a name is unknown
+pub fn toIR(self: @This(), alloc: std.mem.Allocator, ast: *Ast, prog: *IR.Program, m: tb.Module) std.mem.Allocator.Error!?IR.Function {
+    var f = IR.Function.init(alloc, self, ast, m);
+    var names = std.AutoHashMap(u32, u32).init(alloc);
+    defer names.deinit();
+
+    var ok = true;
     for (self.body.items) |stmt| {
-        const inst = try stmt.toIR(alloc, prog, m);
-        if (inst) |i|
-            try f.body.append(i);
+        switch (stmt) {
+            .ret => |r| ok = resolve(ast, r.expr, &names) and ok,
+            .let => |v| ok = resolve(ast, v.expr, &names) and ok,
+            .func => {},
+        }
+
+        var inst = try stmt.toIR(alloc, ast, prog, m) orelse continue;
+        if (inst == .variable) {
+            // Bound after its expression, `let a = a + 1` reads the old a
+            inst.variable.slot = f.locals;
+            try names.put(inst.variable.id, f.locals);
+            f.locals += 1;
+        }
+        try f.body.append(inst);
     }
 
-    return f;
+    return if (ok) f else null;
+}
+
+fn resolve(ast: *Ast, e: Expression, names: *const std.AutoHashMap(u32, u32)) bool {
+    switch (ast.tag(e)) {
+        // Decoded into constants by the type check
+        .leaf => unreachable,
+        .constant => return true,
+        .variable => {
+            const s = names.get(ast.get(e).lhs) orelse {
+                Logger.logLocation.err(ast.loc(e), "Unknown variable {s}", .{ast.str(e)});
+                return false;
+            };
+            ast.setSlot(e, s);
+            return true;
+        },
+        .paren, .una => return resolve(ast, ast.lhs(e), names),
+        .bin => {
+            const left = resolve(ast, ast.lhs(e), names);
+            const right = resolve(ast, ast.rhs(e), names);
+            return left and right;
+        },
+    }
 }
 
-pub fn toString(self: @This(), cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
+pub fn toString(self: @This(), ast: *const Ast, cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
     for (0..d) |_|
         try cont.append(' ');
 
@@ -126,6 +175,6 @@ pub fn toString(self: @This(), cont: *std.ArrayList(u8), d: u64) std.mem.Allocat
     try cont.appendSlice("Body:\n");
 
     for (self.body.items) |statement| {
-        try statement.toString(cont, d + 4);
+        try statement.toString(ast, cont, d + 4);
     }
 }
@@ -17,6 +17,7 @@ const TokenType = Lexer.TokenType;
 const Token = Lexer.Token;
 const Location = Lexer.Location;
 
+pub const Ast = @import("./Ast.zig");
 pub const Expression = @import("./Expression.zig").Expression;
 pub const Function = @import("./Function.zig");
 pub const Return = @import("./Return.zig");
@@ -31,24 +32,25 @@ l: *Lexer,
 alloc: Allocator,
 program: Program,
 errors: std.ArrayList(UnexpectedToken),
-temp: std.ArrayList(TokenType),
+// Scratch stacks of Expression.parse, cleared and reused for every expression
+operands: std.ArrayList(Expression),
+operators: std.ArrayList(Expression.Pending),
 
 pub fn init(alloc: Allocator, l: *Lexer) @This() {
     return @This(){
         .alloc = alloc,
         .l = l,
-        .program = Program.init(alloc),
+        .program = Program.init(alloc, l),
         .errors = std.ArrayList(UnexpectedToken).init(alloc),
-        .temp = std.ArrayList(TokenType).init(alloc),
+        .operands = std.ArrayList(Expression).init(alloc),
+        .operators = std.ArrayList(Expression.Pending).init(alloc),
     };
 }
 
 pub fn deinit(self: *@This()) void {
-    for (self.errors.items) |value| {
-        value.deinit();
-    }
-
     self.errors.deinit();
+    self.operands.deinit();
+    self.operators.deinit();
     self.program.deinit();
 }
 
@@ -57,21 +59,30 @@ pub fn parse(self: *@This()) (std.mem.Allocator.Error || error{UnexpectedToken})
     if (self.errors.items.len > 0) return error.UnexpectedToken;
 }
 
-pub fn expect(self: *@This(), token: Token, t: []const TokenType) std.mem.Allocator.Error!bool {
-    const ex = try self.alloc.dupe(Lexer.TokenType, t);
-    const is = util.listContains(TokenType, ex, token.type);
+// The expected set is folded at compile time, a match never allocates
+pub fn expect(self: *@This(), token: Token, comptime t: []const TokenType) std.mem.Allocator.Error!bool {
+    const expected = comptime UnexpectedToken.Expected.initMany(t);
+    const is = expected.contains(token.type);
     if (!is)
         try self.errors.append(UnexpectedToken{
-            .expected = ex,
+            .expected = expected,
             .found = token.type,
             .loc = token.loc,
-            .path = token.path,
-            .alloc = self.alloc,
         });
 
     return is;
 }
 
+// Reported with the other errors of the unit, in file order
+pub fn unknownOperator(self: *@This(), token: Token, kind: UnexpectedToken.Kind) std.mem.Allocator.Error!void {
+    try self.errors.append(UnexpectedToken{
+        .kind = kind,
+        .found = token.type,
+        .str = token.str,
+        .loc = token.loc,
+    });
+}
+
 pub fn parseGlobalScope(self: *@This()) (std.mem.Allocator.Error || error{UnexpectedToken})!void {
     var t = self.l.peek();
     if (t.type == .EOF) return;
@@ -79,7 +90,7 @@ pub fn parseGlobalScope(self: *@This()) (std.mem.Allocator.Error || error{Unexpe
         switch (t.type) {
             .func => {
                 const r = try Function.parse(self);
-                try self.program.funcs.put(r.name, r);
+                try self.program.funcs.append(r);
             },
             else => {
                 _ = if (!try self.expect(t, &[_]Lexer.TokenType{.func})) return error.UnexpectedToken;
@@ -38,52 +38,19 @@ pub fn getType(str: []const u8) @This() {
     return t;
 }
 
-pub fn possibleValue(self: @This(), expr: *Expression) bool {
-    _ = self;
-    _ = expr;
-    return true;
-    // TODO: I do not know how to do it
-    // switch (self.type) {
-    //     .void => return expr.expr.str.len == 0,
-    //     .bool => {
-    //         if (expr.expr.str.len == 1) {
-    //             return expr.expr.str[0] == '0' or expr.expr.str[0] == '1';
-    //         }
-    //         return std.mem.eql(u8, expr.expr.str, "false") or std.mem.eql(u8, expr.expr.str, "true");
-    //     },
-    //     .signed => {
-    //         if (self.size == 8) {
-    //             _ = std.fmt.parseInt(i8, expr.expr.str, 10) catch return false;
-    //         } else if (self.size == 16) {
-    //             _ = std.fmt.parseInt(i16, expr.expr.str, 10) catch return false;
-    //         } else if (self.size == 32) {
-    //             _ = std.fmt.parseInt(i32, expr.expr.str, 10) catch return false;
-    //         } else if (self.size == 64) {
-    //             _ = std.fmt.parseInt(i64, expr.expr.str, 10) catch return false;
-    //         }
-    //         return true;
-    //     },
-    //     .unsigned => {
-    //         if (self.size == 8) {
-    //             _ = std.fmt.parseUnsigned(u8, expr.expr.str, 10) catch return false;
-    //         } else if (self.size == 16) {
-    //             _ = std.fmt.parseUnsigned(u16, expr.expr.str, 10) catch return false;
-    //         } else if (self.size == 32) {
-    //             _ = std.fmt.parseUnsigned(u32, expr.expr.str, 10) catch return false;
-    //         } else if (self.size == 64) {
-    //             _ = std.fmt.parseUnsigned(u64, expr.expr.str, 10) catch return false;
-    //         }
-    //         return true;
-    //     },
-    //     .float => {
-    //         if (self.size == 32) {
-    //             _ = std.fmt.parseFloat(f32, expr.expr.str) catch return false;
-    //         } else if (self.size == 64) {
-    //             _ = std.fmt.parseFloat(f64, expr.expr.str) catch return false;
-    //         }
-    //         return true;
-    //     },
-    // }
+// v is the decoded literal, a negated literal may reach one past the signed maximum
+pub fn possibleValue(self: @This(), v: u64, negated: bool) bool {
+    return switch (self.type) {
+        .void => false,
+        .bool => v <= 1,
+        .unsigned => self.size >= 64 or v < @as(u64, 1) << @intCast(self.size),
+        .signed => {
+            const limit = @as(u64, 1) << @intCast(self.size - 1);
+            return if (negated) v <= limit else v < limit;
+        },
+        // Integer literals always have a float value, maybe rounded
+        .float => true,
+    };
 }
 
 pub fn toString(self: @This(), cont: *std.ArrayList(u8)) std.mem.Allocator.Error!void {
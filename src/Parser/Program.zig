@@ -2,23 +2,41 @@ const std = @import("std");
 
 const Parser = @import("./Parser.zig");
 const Function = Parser.Function;
+const Ast = Parser.Ast;
 
-funcs: std.StringHashMap(Function),
+const Lexer = @import("../Lexer/Lexer.zig");
+const Intern = @import("../Lexer/Intern.zig");
 
-pub fn init(alloc: std.mem.Allocator) @This() {
+// Source order, duplicates are kept so they can be reported when files are merged
+funcs: std.ArrayList(Function),
+idens: *const Intern,
+// Every expression node of the program
+ast: Ast,
+
+pub fn init(alloc: std.mem.Allocator, lexer: *Lexer) @This() {
     return .{
-        .funcs = std.StringHashMap(Function).init(alloc),
+        .funcs = std.ArrayList(Function).init(alloc),
+        .idens = &lexer.idens,
+        .ast = Ast.init(alloc, lexer),
     };
 }
 
 pub fn deinit(self: *@This()) void {
     self.funcs.deinit();
+    self.ast.deinit();
 }
 
-pub fn toString(self: @This(), cont: *std.ArrayList(u8)) std.mem.Allocator.Error!void {
-    var it = self.funcs.iterator();
+pub fn lookup(self: @This(), name: []const u8) ?Function {
+    const id = self.idens.lookup(name) orelse return null;
+    for (self.funcs.items) |f| {
+        if (f.id == id) return f;
+    }
 
-    while (it.next()) |state| {
-        try state.value_ptr.toString(cont, 0);
+    return null;
+}
+
+pub fn toString(self: @This(), cont: *std.ArrayList(u8)) std.mem.Allocator.Error!void {
+    for (self.funcs.items) |f| {
+        try f.toString(&self.ast, cont, 0);
     }
 }
@@ -8,12 +8,13 @@ const Expression = @import("./Expression.zig").Expression;
 
 const Parser = @import("./Parser.zig");
 const UnexpectedToken = Parser.UnexpectedToken;
+const Ast = Parser.Ast;
 
 pub const IR = @import("../IR/IR.zig");
 
 const Util = @import("../Util.zig");
 
-expr: *Expression,
+expr: Expression,
 loc: Location,
 
 pub fn parse(p: *Parser) (std.mem.Allocator.Error || error{UnexpectedToken})!@This() {
@@ -39,11 +40,11 @@ pub fn toIR(self: @This()) IR.Return {
     return IR.Return.init(self.expr);
 }
 
-pub fn toString(self: @This(), cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
+pub fn toString(self: @This(), ast: *const Ast, cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
     for (0..d) |_|
         try cont.append(' ');
 
     try cont.appendSlice("Return: ");
-    try self.expr.toString(cont, d);
+    try self.expr.toString(ast, cont, d);
     try cont.append('\n');
 }
@@ -5,6 +5,7 @@ pub const Function = Parser.Function;
 pub const Return = Parser.Return;
 pub const UnexpectedToken = Parser.UnexpectedToken;
 pub const Variable = Parser.Variable;
+pub const Ast = Parser.Ast;
 
 pub const Lexer = @import("../Lexer/Lexer.zig");
 pub const Token = Lexer.Token;
@@ -36,29 +37,26 @@ pub const Statement = union(enum) {
                 return error.UnexpectedToken;
             },
             else => {
-                const temp = p.temp.addManyAsArray(3) catch unreachable;
-                temp[0] = .ret;
-                temp[1] = .let;
                 _ = try p.expect(t, &[_]Lexer.TokenType{ .ret, .let });
                 return error.UnexpectedToken;
             },
         }
     }
 
-    pub fn toIR(self: @This(), alloc: std.mem.Allocator, prog: *IR.Program, m: tb.Module) std.mem.Allocator.Error!?IR.Instruction {
+    pub fn toIR(self: @This(), alloc: std.mem.Allocator, ast: *Ast, prog: *IR.Program, m: tb.Module) std.mem.Allocator.Error!?IR.Instruction {
         switch (self) {
             .ret => |r| return IR.Instruction{ .ret = r.toIR() },
             .let => |v| return IR.Instruction{ .variable = v.toIR() },
-            .func => |f| try prog.funcs.put(f.name, try f.toIR(alloc, prog, m)),
+            .func => |f| _ = try prog.define(f, ast, m),
         }
         return null;
     }
 
-    pub fn toString(self: @This(), cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
+    pub fn toString(self: @This(), ast: *const Ast, cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
         switch (self) {
-            .ret => |ret| try ret.toString(cont, d),
-            .let => |let| try let.toString(cont, d),
-            .func => |func| try func.toString(cont, d),
+            .ret => |ret| try ret.toString(ast, cont, d),
+            .let => |let| try let.toString(ast, cont, d),
+            .func => |func| try func.toString(ast, cont, d),
         }
     }
 };
@@ -6,27 +6,36 @@ const TokenType = Lexer.TokenType;
 const Token = Lexer.Token;
 const Location = Lexer.Location;
 
-expected: []TokenType,
+// Only built when a token does not match, the set itself is a comptime constant
+pub const Expected = std.EnumSet(TokenType);
+
+// An operator token the parser accepted but the operator tables do not contain
+pub const Kind = enum { token, unaryOperator, binaryOperator };
+
+kind: Kind = .token,
+expected: Expected = Expected.initEmpty(),
 found: TokenType,
-path: []const u8,
+// Source text of an unknown operator
+str: []const u8 = "",
 loc: Location,
-alloc: std.mem.Allocator,
 
 pub fn display(self: @This()) void {
+    switch (self.kind) {
+        .token => {},
+        .unaryOperator => return Logger.logLocation.err(self.loc, "Unknown unary operator {s}", .{self.str}),
+        .binaryOperator => return Logger.logLocation.err(self.loc, "Unknown binary operator {s}", .{self.str}),
+    }
+
     var arr = std.BoundedArray(u8, 10 * 1024).init(0) catch return;
 
-    arr.appendSlice(@tagName(self.expected[0])) catch return;
-    for (self.expected[1..]) |e| {
-        arr.appendSlice(", ") catch return;
+    var it = self.expected.iterator();
+    while (it.next()) |e| {
+        if (arr.len > 0) arr.appendSlice(", ") catch return;
         arr.appendSlice(@tagName(e)) catch return;
     }
 
     Logger.logLocation.err(self.loc, "Expected: {s} but found: {s}", .{
-        arr.buffer,
+        arr.slice(),
         @tagName(self.found),
     });
 }
-
-pub fn deinit(self: @This()) void {
-    self.alloc.free(self.expected);
-}
@@ -5,6 +5,7 @@ const Parser = @import("./Parser.zig");
 const Expression = Parser.Expression;
 const Primitive = Parser.Primitive;
 const UnexpectedToken = Parser.UnexpectedToken;
+const Ast = Parser.Ast;
 
 const Lexer = @import("./../Lexer/Lexer.zig");
 
@@ -15,19 +16,20 @@ const Util = @import("./../Util.zig");
 mut: bool,
 
 name: []const u8,
+id: u32,
 loc: Lexer.Location,
 
 t: Primitive,
-expr: *Expression,
+expr: Expression,
 
 pub fn parse(p: *Parser) (std.mem.Allocator.Error || error{UnexpectedToken})!@This() {
     const letToken = p.l.peek();
     assert(letToken.type == .let);
     _ = p.l.pop();
 
-    const mutToken = p.l.peek();
-    if (!try p.expect(mutToken, &[_]Lexer.TokenType{.mut})) return error.UnexpectedToken;
-    _ = p.l.pop();
+    // Without mut the binding is immutable
+    const mut = p.l.peek().type == .mut;
+    if (mut) _ = p.l.pop();
 
     const name = p.l.peek();
     if (!try p.expect(name, &[_]Lexer.TokenType{.iden})) return error.UnexpectedToken;
@@ -54,8 +56,9 @@ pub fn parse(p: *Parser) (std.mem.Allocator.Error || error{UnexpectedToken})!@Th
     _ = p.l.pop();
 
     return @This(){
-        .mut = true,
+        .mut = mut,
         .name = name.str,
+        .id = name.id,
         .loc = letToken.loc,
         .t = Primitive.getType(t.str),
         .expr = expr,
@@ -66,7 +69,7 @@ pub fn toIR(self: @This()) IR.Variable {
     return IR.Variable.init(self);
 }
 
-pub fn toString(self: @This(), cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
+pub fn toString(self: @This(), ast: *const Ast, cont: *std.ArrayList(u8), d: u64) std.mem.Allocator.Error!void {
     for (0..d) |_|
         try cont.append(' ');
 
@@ -77,6 +80,6 @@ pub fn toString(self: @This(), cont: *std.ArrayList(u8), d: u64) std.mem.Allocat
     try cont.append(' ');
     try self.t.toString(cont);
     try cont.appendSlice(" = ");
-    try self.expr.toString(cont, d);
+    try self.expr.toString(ast, cont, d);
     try cont.append('\n');
 }
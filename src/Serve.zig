@@ -0,0 +1,303 @@
+const std = @import("std");
+const posix = std.posix;
+const Logger = @import("Logger.zig");
+
+const ParseArgs = @import("ParseArgs.zig");
+const Arguments = ParseArgs.Arguments;
+const Session = @import("Session.zig");
+const usage = @import("General.zig").usage;
+
+// serve keeps one process with a warm Session and runs the requests clients
+// send over a Unix socket, client is the thin side of it. A connection carries
+// any number of requests, each one is answered before the next is read.
+//
+// Request: u32 count, then count strings, each a u32 length and its bytes. The
+// first is the directory of the client, the rest the arguments to run.
+// Response: the exit code byte, the signal that killed the program or 0, then
+// stdout and stderr as length and bytes. Integers are little endian. The program
+// itself runs in a forked child (Session.execute), when it crashes the server
+// lives on and the client dies of the same signal
+pub const Compile = *const fn (std.mem.Allocator, Arguments, *Session) u8;
+
+const maxStrings = 1024;
+const maxString = 64 * 1024;
+
+// stdout and stderr of the request go to memory files while it runs
+const Capture = struct {
+    files: [2]posix.fd_t,
+    saved: [2]posix.fd_t,
+
+    fn init() !Capture {
+        var c: Capture = undefined;
+        for (&c.files, &c.saved, [_][]const u8{ "yot stdout", "yot stderr" }, 1..) |*f, *s, name, fd| {
+            f.* = try posix.memfd_create(name, 0);
+            s.* = try posix.dup(@intCast(fd));
+        }
+        return c;
+    }
+
+    // Truncating leaves the offset where the last request stopped, 1 and 2 share it
+    fn begin(self: Capture) !void {
+        for (self.files, 1..) |f, fd| {
+            try posix.ftruncate(f, 0);
+            try posix.lseek_SET(f, 0);
+            try posix.dup2(f, @intCast(fd));
+        }
+    }
+
+    fn end(self: Capture, alloc: std.mem.Allocator) ![2][]u8 {
+        // TB prints through C stdio
+        _ = std.c.fflush(null);
+
+        var out: [2][]u8 = undefined;
+        for (self.files, self.saved, &out, 1..) |f, s, *o, fd| {
+            try posix.dup2(s, @intCast(fd));
+            o.* = try alloc.alloc(u8, @intCast((try posix.fstat(f)).size));
+            _ = try (std.fs.File{ .handle = f }).preadAll(o.*, 0);
+        }
+        return out;
+    }
+};
+
+pub fn serve(arena: *std.heap.ArenaAllocator, session: *Session, socket: []const u8, compile: Compile) u8 {
+    // Left behind by a server that did not exit cleanly
+    std.fs.cwd().deleteFile(socket) catch {};
+
+    const address = std.net.Address.initUnix(socket) catch |err| {
+        Logger.log.err("Invalid socket path {s} because {}", .{ socket, err });
+        return 1;
+    };
+    var server = address.listen(.{}) catch |err| {
+        Logger.log.err("Could not listen on {s} because {}", .{ socket, err });
+        return 1;
+    };
+    defer server.deinit();
+
+    const capture = Capture.init() catch |err| {
+        Logger.log.err("Could not capture the output because {}", .{err});
+        return 1;
+    };
+
+    session.isolate = true;
+    Logger.log.info("Serving on {s}", .{socket});
+    while (true) {
+        const conn = server.accept() catch |err| {
+            Logger.log.err("Could not accept a connection because {}", .{err});
+            continue;
+        };
+        defer conn.stream.close();
+
+        handle(conn.stream, arena, session, capture, compile) catch |err| {
+            Logger.log.err("Connection dropped because {}", .{err});
+        };
+    }
+}
+
+fn handle(stream: std.net.Stream, arena: *std.heap.ArenaAllocator, session: *Session, capture: Capture, compile: Compile) !void {
+    var br = std.io.bufferedReader(stream.reader());
+    var bw = std.io.bufferedWriter(stream.writer());
+
+    while (true) {
+        _ = arena.reset(.retain_capacity);
+        const alloc = arena.allocator();
+
+        const request = readStrings(alloc, br.reader()) catch |err| switch (err) {
+            error.EndOfStream => return,
+            else => return err,
+        };
+        if (request.len == 0) return error.InvalidRequest;
+
+        try capture.begin();
+        const code = run(alloc, request, session, compile);
+        const signal = session.signal;
+        const out = try capture.end(alloc);
+        session.reset();
+
+        const w = bw.writer();
+        try w.writeByte(code);
+        try w.writeByte(signal);
+        for (out) |o| {
+            try w.writeInt(u32, @intCast(o.len), .little);
+            try w.writeAll(o);
+        }
+        try bw.flush();
+    }
+}
+
+fn run(alloc: std.mem.Allocator, request: []const []const u8, session: *Session, compile: Compile) u8 {
+    // Relative paths and outputs are the client's
+    posix.chdir(request[0]) catch |err| {
+        Logger.log.err("Could not enter {s} because {}", .{ request[0], err });
+        return 1;
+    };
+
+    const arguments = ParseArgs.parse(request[1..]) orelse {
+        usage();
+        return 1;
+    };
+    if (arguments.serve or arguments.client) {
+        Logger.log.err("serve and client can not be requested", .{});
+        return 1;
+    }
+
+    return compile(alloc, arguments, session);
+}
+
+fn readStrings(alloc: std.mem.Allocator, r: anytype) ![]const []const u8 {
+    const count = try r.readInt(u32, .little);
+    if (count > maxStrings) return error.InvalidRequest;
+
+    const strings = try alloc.alloc([]const u8, count);
+    for (strings) |*s| {
+        const len = try r.readInt(u32, .little);
+        if (len > maxString) return error.InvalidRequest;
+        const buf = try alloc.alloc(u8, len);
+        try r.readNoEof(buf);
+        s.* = buf;
+    }
+    return strings;
+}
+
+fn writeStrings(w: anytype, strings: []const []const u8) !void {
+    try w.writeInt(u32, @intCast(strings.len), .little);
+    for (strings) |s| {
+        try w.writeInt(u32, @intCast(s.len), .little);
+        try w.writeAll(s);
+    }
+}
+
+pub fn client(alloc: std.mem.Allocator, arguments: Arguments) u8 {
+    const stream = std.net.connectUnixSocket(arguments.socket) catch |err| {
+        Logger.log.err("Could not connect to {s} because {}, is yot serve running?", .{ arguments.socket, err });
+        return 1;
+    };
+    defer stream.close();
+
+    const request = alloc.alloc([]const u8, arguments.forward.len + 1) catch {
+        Logger.log.err("Out of memory", .{});
+        return 1;
+    };
+    request[0] = std.process.getCwdAlloc(alloc) catch |err| {
+        Logger.log.err("Could not get the current directory because {}", .{err});
+        return 1;
+    };
+    @memcpy(request[1..], arguments.forward);
+
+    var timer = std.time.Timer.start() catch unreachable;
+    var status = Status{ .code = 0, .signal = 0 };
+    for (0..arguments.repeat) |i| {
+        status = exchange(alloc, stream, request, i + 1 == arguments.repeat) catch |err| {
+            Logger.log.err("Lost the server because {}", .{err});
+            return 1;
+        };
+    }
+
+    if (arguments.repeat > 1) {
+        const ns = timer.read();
+        Logger.log.info("{} requests in {} ({d:.0} requests/s)", .{
+            arguments.repeat,
+            std.fmt.fmtDuration(ns),
+            @as(f64, @floatFromInt(arguments.repeat)) * std.time.ns_per_s / @as(f64, @floatFromInt(@max(ns, 1))),
+        });
+    }
+
+    if (status.signal != 0) die(status.signal);
+    return status.code;
+}
+
+const Status = struct {
+    code: u8,
+    signal: u8,
+};
+
+// Ends the client the way the program ended in the server. The default action,
+// not the handler Zig installs for SIGILL, SIGFPE and SIGSEGV
+fn die(signal: u8) void {
+    const sig: u6 = @intCast(signal);
+    const act = posix.Sigaction{
+        .handler = .{ .handler = posix.SIG.DFL },
+        .mask = posix.empty_sigset,
+        .flags = 0,
+    };
+    posix.sigaction(sig, &act, null) catch {};
+    posix.raise(sig) catch {};
+}
+
+// Only the output of the last request is shown, the others are there to be timed
+fn exchange(alloc: std.mem.Allocator, stream: std.net.Stream, request: []const []const u8, show: bool) !Status {
+    var bw = std.io.bufferedWriter(stream.writer());
+    try writeStrings(bw.writer(), request);
+    try bw.flush();
+
+    var br = std.io.bufferedReader(stream.reader());
+    const r = br.reader();
+    const code = try r.readByte();
+    const signal = try r.readByte();
+    for ([_]std.fs.File{ std.io.getStdOut(), std.io.getStdErr() }) |f| {
+        const len = try r.readInt(u32, .little);
+        const buf = try alloc.alloc(u8, len);
+        defer alloc.free(buf);
+        try r.readNoEof(buf);
+        if (show) try f.writeAll(buf);
+    }
+
+    return .{ .code = code, .signal = signal };
+}
+
+// Stands in for compile, prints its sources and returns how many there are
+fn echo(_: std.mem.Allocator, arguments: Arguments, _: *Session) u8 {
+    const out = std.io.getStdOut().writer();
+    for (arguments.paths) |p| out.print("{s}\n", .{p}) catch {};
+    return @intCast(arguments.paths.len);
+}
+
+fn serveOne(stream: std.net.Stream, arena: *std.heap.ArenaAllocator, session: *Session, capture: Capture) void {
+    defer stream.close();
+    handle(stream, arena, session, capture, &echo) catch |err| std.debug.panic("handle failed with {}", .{err});
+}
+
+test "two requests on one connection" {
+    const alloc = std.testing.allocator;
+
+    var fds: [2]i32 = undefined;
+    try std.testing.expectEqual(@as(usize, 0), std.os.linux.socketpair(posix.AF.UNIX, posix.SOCK.STREAM, 0, &fds));
+    const stream = std.net.Stream{ .handle = fds[1] };
+    defer stream.close();
+
+    var session: Session = undefined;
+    try session.init(false);
+    defer session.deinit();
+    var arena = std.heap.ArenaAllocator.init(alloc);
+    defer arena.deinit();
+    const capture = try Capture.init();
+
+    const thread = try std.Thread.spawn(.{}, serveOne, .{ std.net.Stream{ .handle = fds[0] }, &arena, &session, capture });
+
+    const cwd = try std.process.getCwdAlloc(alloc);
+    defer alloc.free(cwd);
+
+    // The first output is longer, a second one written at its old offset would start with zeros
+    const w = stream.writer();
+    try writeStrings(w, &.{ cwd, "lex", "first.yt", "second.yt" });
+    try writeStrings(w, &.{ cwd, "lex", "third.yt" });
+    try posix.shutdown(stream.handle, .send);
+
+    const expected = [_]struct { code: u8, out: []const u8 }{
+        .{ .code = 2, .out = "first.yt\nsecond.yt\n" },
+        .{ .code = 1, .out = "third.yt\n" },
+    };
+
+    const r = stream.reader();
+    for (expected) |e| {
+        try std.testing.expectEqual(e.code, try r.readByte());
+        try std.testing.expectEqual(@as(u8, 0), try r.readByte());
+        for ([_][]const u8{ e.out, "" }) |want| {
+            const got = try alloc.alloc(u8, try r.readInt(u32, .little));
+            defer alloc.free(got);
+            try r.readNoEof(got);
+            try std.testing.expectEqualStrings(want, got);
+        }
+    }
+
+    thread.join();
+}
@@ -0,0 +1,111 @@
+const std = @import("std");
+const posix = std.posix;
+const Logger = @import("Logger.zig");
+
+const CodeGen = @import("CodeGen.zig");
+
+const tb = @import("libs/tb/tb.zig");
+
+// What one compile can leave to the next: the export arena, the worklist of
+// the builder and tb_opt, the codegen workers and, for serve, a thread pool.
+// The command line makes one for its only compile, serve keeps it warm.
+// Lives outside the per compile allocator, which serve resets every request
+arena: tb.Arena,
+ws: tb.Worklist,
+workers: []CodeGen.Worker,
+pool: ?*std.Thread.Pool,
+// Set by serve, user code then runs in a forked child
+isolate: bool,
+// How the last child that did not return ended: the exit code compile reports
+// and the signal that killed it, 0 if none
+status: u8,
+signal: u8,
+
+const alloc = std.heap.page_allocator;
+
+// Initialized in place, the arena can not move
+pub fn init(self: *@This(), pooled: bool) std.mem.Allocator.Error!void {
+    tb.Arena.create(&self.arena, "For main Module");
+    self.ws = tb.Worklist.alloc();
+    self.workers = try CodeGen.Worker.createAll(alloc);
+    self.pool = null;
+    self.isolate = false;
+    self.status = 0;
+    self.signal = 0;
+
+    if (pooled) {
+        const pool = try alloc.create(std.Thread.Pool);
+        pool.init(.{ .allocator = alloc }) catch {
+            alloc.destroy(pool);
+            return;
+        };
+        self.pool = pool;
+    }
+}
+
+pub fn deinit(self: *@This()) void {
+    if (self.pool) |pool| {
+        pool.deinit();
+        alloc.destroy(pool);
+    }
+    CodeGen.Worker.destroyAll(alloc, self.workers);
+    self.ws.free();
+    self.arena.destroy();
+}
+
+// Everything the last compile emitted is dead once it returned
+pub fn reset(self: *@This()) void {
+    self.arena.clear();
+    for (self.workers) |*w| w.arena.clear();
+    self.status = 0;
+    self.signal = 0;
+}
+
+// Calls f with args, under serve in a child so a trap, a division by zero or
+// an exit in the program only ends the child. The result comes back through a
+// shared page. Null when the child did not return, status and signal say why.
+// Forked after the thread pool did its work, f must not use it
+pub fn execute(self: *@This(), comptime T: type, comptime f: anytype, args: anytype) ?T {
+    if (!self.isolate) return @call(.auto, f, args);
+
+    const Shared = struct {
+        done: bool,
+        value: T,
+    };
+
+    const size = std.mem.alignForward(usize, @sizeOf(Shared), std.mem.page_size);
+    const page = posix.mmap(null, size, posix.PROT.READ | posix.PROT.WRITE, .{ .TYPE = .SHARED, .ANONYMOUS = true }, -1, 0) catch |err| {
+        Logger.log.err("Could not map the result page because {}", .{err});
+        self.status = 1;
+        return null;
+    };
+    defer posix.munmap(page);
+    const shared: *Shared = @ptrCast(page.ptr);
+    shared.done = false;
+
+    const pid = posix.fork() catch |err| {
+        Logger.log.err("Could not fork because {}", .{err});
+        self.status = 1;
+        return null;
+    };
+
+    if (pid == 0) {
+        shared.value = @call(.auto, f, args);
+        shared.done = true;
+        // Skips the atexit handlers of the server, the output still has to reach the capture
+        _ = std.c.fflush(null);
+        std.c._exit(0);
+    }
+
+    const status = posix.waitpid(pid, 0).status;
+    if (shared.done) return shared.value;
+
+    if (posix.W.IFSIGNALED(status)) {
+        self.signal = @intCast(posix.W.TERMSIG(status));
+        // What a shell reports for a program killed by a signal
+        self.status = 128 +% self.signal;
+    } else {
+        self.status = posix.W.EXITSTATUS(status);
+    }
+    return null;
+}
@@ -0,0 +1,180 @@
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+
+const Instruction = @import("Instruction.zig");
+const Op = Instruction.Op;
+const Width = Instruction.Width;
+
+const Parser = @import("../Parser/Parser.zig");
+const Primitive = Parser.Primitive;
+const Expression = Parser.Expression;
+const Ast = Parser.Ast;
+
+const IR = @import("../IR/IR.zig");
+const Overflow = @import("../ParseArgs.zig").Overflow;
+
+// Bytecode of one function. Every let gets its own register for its whole
+// lifetime, resolved here, temporaries live above them and are reused per statement
+code: []const Instruction,
+consts: []const u64,
+registers: u16,
+
+const Slot = struct {
+    register: u16,
+    width: Width,
+    signed: bool,
+};
+
+const Builder = struct {
+    ast: *const Ast,
+    code: std.ArrayList(Instruction),
+    consts: std.ArrayList(u64),
+    // Indexed by the slot the IR gave each let
+    slots: []Slot,
+    // One past the last slot, temporaries start here
+    live: u16 = 0,
+    next: u16 = 0,
+    registers: u16 = 0,
+    signed: bool = false,
+    // -safe picks the checked ops, -fast promises no overflow so wrapping is as good as anything
+    safe: bool,
+
+    fn temp(self: *@This()) u16 {
+        const r = self.next;
+        self.next += 1;
+        self.registers = @max(self.registers, self.next);
+        return r;
+    }
+
+    fn emit(self: *@This(), inst: Instruction) Allocator.Error!void {
+        try self.code.append(inst);
+    }
+
+    fn constant(self: *@This(), v: u64) Allocator.Error!u16 {
+        const index: u32 = @intCast(self.consts.items.len);
+        try self.consts.append(v);
+
+        const dst = self.temp();
+        try self.emit(.{ .op = .constant, .dst = dst, .a = @truncate(index), .b = @truncate(index >> 16) });
+        return dst;
+    }
+
+    // Register holding the value of e, variables are read in place
+    fn expr(self: *@This(), e: Expression, width: Width) Allocator.Error!u16 {
+        const ast = self.ast;
+        const node = ast.get(e);
+        switch (node.tag) {
+            // Decoded into constants by the type check
+            .leaf => unreachable,
+            .constant => return self.constant(ast.value(e) & width.mask()),
+            // Narrower variables are extended by their own signedness, like tbHelper.resize
+            .variable => {
+                const slot = self.slots[ast.slot(e)];
+                if (slot.width == width or (!slot.signed and @intFromEnum(slot.width) < @intFromEnum(width))) return slot.register;
+
+                const dst = self.temp();
+                if (@intFromEnum(slot.width) > @intFromEnum(width)) {
+                    try self.emit(.{ .op = .trunc, .width = width, .dst = dst, .a = slot.register });
+                } else {
+                    try self.emit(.{ .op = .sext, .width = width, .dst = dst, .a = slot.register, .b = @intFromEnum(slot.width) });
+                }
+                return dst;
+            },
+            .paren => return self.expr(ast.lhs(e), width),
+            .una => {
+                const a = try self.expr(ast.lhs(e), width);
+                const dst = self.temp();
+                const op: Op = if (!self.safe) .neg else if (self.signed) .sneg else .uneg;
+                try self.emit(.{ .op = op, .width = width, .dst = dst, .a = a });
+                return dst;
+            },
+            .bin => {
+                const a = try self.expr(ast.lhs(e), width);
+                const b = try self.expr(ast.rhs(e), width);
+                const dst = self.temp();
+                try self.emit(.{ .op = binary(ast.str(e)[0], self.signed, self.safe), .width = width, .dst = dst, .a = a, .b = b });
+                return dst;
+            },
+        }
+    }
+};
+
+fn binary(op: u8, signed: bool, safe: bool) Op {
+    return switch (op) {
+        '+' => if (!safe) .add else if (signed) .sadd else .uadd,
+        '-' => if (!safe) .sub else if (signed) .ssub else .usub,
+        '*' => if (!safe) .mul else if (signed) .smul else .umul,
+        '/' => if (signed) .sdiv else .udiv,
+        '%' => if (signed) .smod else .umod,
+        '^' => if (!safe) .pow else if (signed) .spow else .upow,
+        else => unreachable,
+    };
+}
+
+// Floats are refused instead of run through integer ops
+pub fn compile(alloc: Allocator, f: IR.Function, overflow: Overflow) (Allocator.Error || error{UnsupportedFloat})!@This() {
+    if (f.returnType.type == .float) return error.UnsupportedFloat;
+
+    var b = Builder{
+        .safe = overflow == .safe,
+        .ast = f.ast,
+        .code = std.ArrayList(Instruction).init(alloc),
+        .consts = std.ArrayList(u64).init(alloc),
+        .slots = try alloc.alloc(Slot, f.locals),
+    };
+    defer alloc.free(b.slots);
+
+    for (f.body.items) |inst| {
+        switch (inst) {
+            .ret => |ret| {
+                b.signed = f.returnType.type == .signed;
+                const r = try b.expr(ret.expr, Width.fromSize(f.returnType.size));
+                try b.emit(.{ .op = .ret, .a = r });
+            },
+            .variable => |v| {
+                if (v.t.type == .float) return error.UnsupportedFloat;
+                b.signed = v.t.type == .signed;
+                const width = Width.fromSize(v.t.size);
+                const r = try b.expr(v.expr, width);
+
+                // A temporary result is always the dst of the last instruction, which
+                // reads its operands before writing, so it can write the slot directly.
+                // The slot replaces the name after the expression, `let a = a + 1` reads the old a
+                const slot = b.live;
+                if (r >= b.live) {
+                    b.code.items[b.code.items.len - 1].dst = slot;
+                } else {
+                    try b.emit(.{ .op = .move, .dst = slot, .a = r });
+                }
+
+                b.live += 1;
+                b.registers = @max(b.registers, b.live);
+                b.slots[v.slot] = .{ .register = slot, .width = width, .signed = v.t.type == .signed };
+            },
+            .intrinsic => unreachable,
+        }
+
+        // Temporaries die with the statement, only the slots stay
+        b.next = b.live;
+    }
+
+    // Falling off the end returns 0
+    if (b.code.items.len == 0 or b.code.items[b.code.items.len - 1].op != .ret) {
+        const r = try b.constant(0);
+        try b.emit(.{ .op = .ret, .a = r });
+    }
+
+    return @This(){
+        .code = try b.code.toOwnedSlice(),
+        .consts = try b.consts.toOwnedSlice(),
+        .registers = @max(b.registers, 1),
+    };
+}
+
+pub fn toString(self: @This(), cont: *std.ArrayList(u8)) std.mem.Allocator.Error!void {
+    for (self.code, 0..) |inst, i| {
+        try cont.writer().print("    {:>4}: ", .{i});
+        try inst.toString(cont);
+        try cont.append('\n');
+    }
+}
@@ -0,0 +1,93 @@
+const std = @import("std");
+
+// Fixed 8 byte instruction, operands are register indices of the function frame
+pub const Op = enum(u8) {
+    // dst = consts[a | b << 16]
+    constant,
+    move,
+    // dst = a truncated to width, reading a wider variable
+    trunc,
+    // dst = a sign extended from width b to width, reading a narrower signed variable
+    sext,
+    add,
+    sub,
+    mul,
+    udiv,
+    sdiv,
+    umod,
+    smod,
+    pow,
+    neg,
+    // -safe, trap when the exact result does not fit the width as signed or unsigned
+    sadd,
+    uadd,
+    ssub,
+    usub,
+    smul,
+    umul,
+    spow,
+    upow,
+    sneg,
+    uneg,
+    ret,
+};
+
+// Every result is truncated to the width of the expression, registers never
+// hold bits above it
+pub const Width = enum(u8) {
+    w8,
+    w16,
+    w32,
+    w64,
+
+    pub fn fromSize(size: u8) @This() {
+        return switch (size) {
+            0...8 => .w8,
+            9...16 => .w16,
+            17...32 => .w32,
+            else => .w64,
+        };
+    }
+
+    pub fn mask(self: @This()) u64 {
+        return masks[@intFromEnum(self)];
+    }
+
+    pub fn bits(self: @This()) u7 {
+        return @as(u7, 8) << @intCast(@intFromEnum(self));
+    }
+};
+
+const masks = [_]u64{ 0xff, 0xffff, 0xffff_ffff, 0xffff_ffff_ffff_ffff };
+
+op: Op,
+width: Width = .w64,
+dst: u16 = 0,
+a: u16 = 0,
+b: u16 = 0,
+
+pub fn constIndex(self: @This()) u32 {
+    return @as(u32, self.b) << 16 | self.a;
+}
+
+// Source width of sext
+pub fn from(self: @This()) Width {
+    return @enumFromInt(@as(u8, @intCast(self.b)));
+}
+
+pub fn toString(self: @This(), cont: *std.ArrayList(u8)) std.mem.Allocator.Error!void {
+    const w = cont.writer();
+    switch (self.op) {
+        .constant => try w.print("r{} = const #{}", .{ self.dst, self.constIndex() }),
+        .move => try w.print("r{} = r{}", .{ self.dst, self.a }),
+        .trunc => try w.print("r{} = trunc.{} r{}", .{ self.dst, self.width.bits(), self.a }),
+        .sext => try w.print("r{} = sext.{}.{} r{}", .{ self.dst, self.from().bits(), self.width.bits(), self.a }),
+        .neg, .sneg, .uneg => try w.print("r{} = {s}.{} r{}", .{ self.dst, @tagName(self.op), self.width.bits(), self.a }),
+        .ret => try w.print("ret r{}", .{self.a}),
+        else => try w.print("r{} = {s}.{} r{}, r{}", .{ self.dst, @tagName(self.op), self.width.bits(), self.a, self.b }),
+    }
+}
+
+comptime {
+    std.debug.assert(@sizeOf(@This()) == 8);
+}
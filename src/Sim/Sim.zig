@@ -0,0 +1,70 @@
+const std = @import("std");
+const Logger = @import("../Logger.zig");
+
+const IR = @import("../IR/IR.zig");
+const Overflow = @import("../ParseArgs.zig").Overflow;
+
+pub const Instruction = @import("Instruction.zig");
+pub const Chunk = @import("Chunk.zig");
+pub const Vm = @import("Vm.zig");
+
+// Interpreter tier of sim, the IR is lowered to register bytecode and no
+// executable memory is ever mapped
+pub const Result = struct {
+    value: u8,
+    // Lowering to bytecode, what sim pays before the first instruction
+    startupNs: u64 = 0,
+    // Average of benchRuns executions
+    runNs: u64 = 0,
+    instructions: u64 = 0,
+};
+
+pub const benchRuns = 10_000;
+
+// The bytecode only has integer registers
+pub const Error = std.mem.Allocator.Error || error{UnsupportedFloat};
+
+// Only main is lowered, there are no calls that could reach anything else
+pub fn simulate(alloc: std.mem.Allocator, prog: *const IR.Program, overflow: Overflow, bench: bool) Error!Result {
+    var timer = std.time.Timer.start() catch unreachable;
+
+    const main = prog.lookup("main").?;
+    const chunk = try Chunk.compile(alloc, main, overflow);
+    const regs = try alloc.alloc(u64, chunk.registers);
+    defer alloc.free(regs);
+
+    var result = Result{ .value = undefined };
+    var stats = Vm.Stats{};
+
+    if (!bench) {
+        result.value = @truncate(Vm.run(false, &chunk, regs, &stats));
+        return result;
+    }
+
+    result.startupNs = timer.lap();
+    result.value = @truncate(Vm.run(true, &chunk, regs, &stats));
+    result.instructions = stats.instructions;
+
+    _ = timer.lap();
+    for (0..benchRuns) |_| {
+        std.mem.doNotOptimizeAway(Vm.run(false, &chunk, regs, &stats));
+    }
+    result.runNs = timer.read() / benchRuns;
+
+    var cont = std.ArrayList(u8).init(alloc);
+    defer cont.deinit();
+    try chunk.toString(&cont);
+    Logger.log.info("Bytecode of main, {} registers\n{s}", .{ chunk.registers, cont.items });
+
+    return result;
+}
+
+pub fn report(r: Result) void {
+    const perSecond = @as(f64, @floatFromInt(r.instructions)) * std.time.ns_per_s / @as(f64, @floatFromInt(@max(r.runNs, 1)));
+    Logger.log.info("Sim startup {}, run {} ({} instructions, {d:.0} instructions/s)", .{
+        std.fmt.fmtDuration(r.startupNs),
+        std.fmt.fmtDuration(r.runNs),
+        r.instructions,
+        perSecond,
+    });
+}
@@ -0,0 +1,132 @@
+const std = @import("std");
+
+const Instruction = @import("Instruction.zig");
+const Chunk = @import("Chunk.zig");
+
+// Executed instructions, only counted when asked for so the plain loop stays tight
+pub const Stats = struct {
+    instructions: u64 = 0,
+};
+
+// Division by zero and minInt / -1 end the process like the #DE the JIT
+// code would raise, so both tiers exit the same way
+fn trap() noreturn {
+    std.posix.raise(std.posix.SIG.FPE) catch {};
+    std.process.exit(1);
+}
+
+// -safe overflow, the JIT code runs into the ud2 of its trap
+fn overflowTrap() noreturn {
+    std.posix.raise(std.posix.SIG.ILL) catch {};
+    std.process.exit(1);
+}
+
+// Exact result of the checked ops, operands are read as the signedness of the op
+fn checked(comptime op: Instruction.Op, a: u64, b: u64, width: Instruction.Width) u64 {
+    const signed = switch (op) {
+        .sadd, .ssub, .smul, .sneg => true,
+        .uadd, .usub, .umul, .uneg => false,
+        else => @compileError("not a checked op"),
+    };
+    const x: i128 = if (signed) signExtend(a, width) else a;
+    const y: i128 = if (signed) signExtend(b, width) else b;
+    const r: i128 = switch (op) {
+        .sadd, .uadd => x + y,
+        .ssub, .usub => x - y,
+        // A product that does not even fit in 128 bits does not fit the width either
+        .smul, .umul => std.math.mul(i128, x, y) catch overflowTrap(),
+        .sneg, .uneg => -x,
+        else => unreachable,
+    };
+
+    const bits = width.bits();
+    const min: i128 = if (signed) -(@as(i128, 1) << (bits - 1)) else 0;
+    const max: i128 = if (signed) (@as(i128, 1) << (bits - 1)) - 1 else (@as(i128, 1) << bits) - 1;
+    if (r < min or r > max) overflowTrap();
+
+    return @as(u64, @truncate(@as(u128, @bitCast(r)))) & width.mask();
+}
+
+fn signExtend(v: u64, width: Instruction.Width) i64 {
+    const shift: u6 = @intCast(64 - @as(u8, width.bits()));
+    return @as(i64, @bitCast(v << shift)) >> shift;
+}
+
+fn signedDivide(comptime op: Instruction.Op, a: u64, b: u64, width: Instruction.Width) u64 {
+    const x = signExtend(a, width);
+    const y = signExtend(b, width);
+    if (y == 0) trap();
+    if (y == -1 and x == signExtend(@as(u64, 1) << @intCast(width.bits() - 1), width)) trap();
+
+    return @bitCast(if (op == .sdiv) @divTrunc(x, y) else @rem(x, y));
+}
+
+// Like the -safe code, only the squaring after the last bit may overflow
+fn checkedPower(comptime mul: Instruction.Op, base: u64, exp: u64, width: Instruction.Width) u64 {
+    var result: u64 = 1;
+    var b = base;
+    var n = exp;
+    while (n != 0) {
+        if (n & 1 == 1) result = checked(mul, result, b, width);
+        n >>= 1;
+        if (n == 0) break;
+        b = checked(mul, b, b, width);
+    }
+
+    return result;
+}
+
+fn power(base: u64, exp: u64, mask: u64) u64 {
+    var result: u64 = 1;
+    var b = base;
+    var n = exp;
+    while (n != 0) : (n >>= 1) {
+        if (n & 1 == 1) result = (result *% b) & mask;
+        b = (b *% b) & mask;
+    }
+
+    return result;
+}
+
+// Zig has no computed goto, the switch over a dense u8 enum is lowered to a
+// jump table and every handler jumps straight back to the dispatch
+pub fn run(comptime count: bool, chunk: *const Chunk, regs: []u64, stats: *Stats) u64 {
+    const code = chunk.code;
+    const consts = chunk.consts;
+    var pc: usize = 0;
+
+    while (true) {
+        const i = code[pc];
+        pc += 1;
+        if (count) stats.instructions += 1;
+
+        const mask = i.width.mask();
+        switch (i.op) {
+            .constant => regs[i.dst] = consts[i.constIndex()],
+            .move => regs[i.dst] = regs[i.a],
+            .trunc => regs[i.dst] = regs[i.a] & mask,
+            .sext => regs[i.dst] = @as(u64, @bitCast(signExtend(regs[i.a], i.from()))) & mask,
+            .add => regs[i.dst] = (regs[i.a] +% regs[i.b]) & mask,
+            .sub => regs[i.dst] = (regs[i.a] -% regs[i.b]) & mask,
+            .mul => regs[i.dst] = (regs[i.a] *% regs[i.b]) & mask,
+            .udiv => {
+                const d = regs[i.b];
+                if (d == 0) trap();
+                regs[i.dst] = regs[i.a] / d;
+            },
+            .umod => {
+                const d = regs[i.b];
+                if (d == 0) trap();
+                regs[i.dst] = regs[i.a] % d;
+            },
+            .sdiv => regs[i.dst] = signedDivide(.sdiv, regs[i.a], regs[i.b], i.width) & mask,
+            .smod => regs[i.dst] = signedDivide(.smod, regs[i.a], regs[i.b], i.width) & mask,
+            .pow => regs[i.dst] = power(regs[i.a], regs[i.b], mask),
+            .neg => regs[i.dst] = (0 -% regs[i.a]) & mask,
+            inline .sadd, .uadd, .ssub, .usub, .smul, .umul, .sneg, .uneg => |op| regs[i.dst] = checked(op, regs[i.a], regs[i.b], i.width),
+            .spow => regs[i.dst] = checkedPower(.smul, regs[i.a], regs[i.b], i.width),
+            .upow => regs[i.dst] = checkedPower(.umul, regs[i.a], regs[i.b], i.width),
+            .ret => return regs[i.a],
+        }
+    }
+}
@@ -0,0 +1,376 @@
+const std = @import("std");
+
+const tb = @import("libs/tb/tb.zig");
+
+// Multiply, divide and modulo by a constant rewritten into shifts, masks and
+// multiplications by a magic reciprocal (Hacker's Delight, chapter 10).
+// The rewrites are written against a small backend interface, so the same code
+// builds TB nodes and, in the tests, evaluates on plain integers.
+// Every function returns null when the instruction should be kept as is
+pub const Op = enum {
+    add,
+    sub,
+    mul,
+    @"and",
+    shl,
+    shr,
+    sar,
+};
+
+// Backend building TB nodes, constants take the type of the node they go with
+pub const Builder = struct {
+    g: tb.GraphBuilder,
+
+    fn constant(self: @This(), like: *tb.Node, v: u64) *tb.Node {
+        return self.g.uint(like.dt, v);
+    }
+
+    fn binop(self: @This(), op: Op, a: *tb.Node, b: *tb.Node) *tb.Node {
+        const t = switch (op) {
+            .add => tb.NodeType.ADD,
+            .sub => tb.NodeType.SUB,
+            .mul => tb.NodeType.MUL,
+            .@"and" => tb.NodeType.AND,
+            .shl => tb.NodeType.SHL,
+            .shr => tb.NodeType.SHR,
+            .sar => tb.NodeType.SAR,
+        };
+        return self.g.binopInt(t, a, b, tb.ArithmeticBehavior.NONE);
+    }
+
+    fn extend(self: @This(), x: *tb.Node, signed: bool) *tb.Node {
+        return self.g.cast(tb.typeI64(), if (signed) tb.NodeType.SIGN_EXT else tb.NodeType.ZERO_EXT, x);
+    }
+
+    fn truncate(self: @This(), x: *tb.Node, like: *tb.Node) *tb.Node {
+        return self.g.cast(like.dt, tb.NodeType.TRUNCATE, x);
+    }
+};
+
+// Lowers x op c for an integer expression of the given width
+pub fn lower(g: tb.GraphBuilder, op: u8, x: *tb.Node, c: u64, w: u8, signed: bool) ?*tb.Node {
+    const b = Builder{ .g = g };
+    return switch (op) {
+        '*' => multiply(b, x, c, w),
+        '/' => divide(b, x, c, w, signed),
+        '%' => modulo(b, x, c, w, signed),
+        else => null,
+    };
+}
+
+// Two shifts and an add or sub at most, anything else stays a MUL.
+// Wrapping multiplication is the same for signed and unsigned
+pub fn multiply(b: anytype, x: anytype, c: u64, w: u8) ?@TypeOf(x) {
+    const v = c & mask(w);
+    if (v == 0) return b.constant(x, 0);
+    if (isPowerOfTwo(v)) return shl(b, x, @ctz(v), w);
+
+    // Two bits set, (x << high) + (x << low)
+    const low: u32 = @ctz(v);
+    const rest = v & (v - 1);
+    if (isPowerOfTwo(rest)) return b.binop(.add, shl(b, x, @ctz(rest), w), shl(b, x, low, w));
+
+    // A single run of ones, (x << (end of the run)) - (x << low)
+    const run = (v >> @intCast(low)) +% 1;
+    if (isPowerOfTwo(run) and low + @ctz(run) < w) {
+        return b.binop(.sub, shl(b, x, low + @ctz(run), w), shl(b, x, low, w));
+    }
+
+    // A negated power of two, 0 - (x << k)
+    const negated = (0 -% v) & mask(w);
+    if (isPowerOfTwo(negated)) return b.binop(.sub, b.constant(x, 0), shl(b, x, @ctz(negated), w));
+
+    return null;
+}
+
+pub fn divide(b: anytype, x: anytype, d: u64, w: u8, signed: bool) ?@TypeOf(x) {
+    const v = d & mask(w);
+    return if (signed) divideSigned(b, x, v, w) else divideUnsigned(b, x, v, w);
+}
+
+pub fn modulo(b: anytype, x: anytype, d: u64, w: u8, signed: bool) ?@TypeOf(x) {
+    const v = d & mask(w);
+    if (!signed and isPowerOfTwo(v)) return b.binop(.@"and", x, b.constant(x, v - 1));
+
+    // x - x / d * d, the multiply is reduced too when it can be
+    const q = divide(b, x, v, w, signed) orelse return null;
+    const product = multiply(b, q, v, w) orelse b.binop(.mul, q, b.constant(x, v));
+    return b.binop(.sub, x, product);
+}
+
+// Division by zero is left to the instruction so it still traps
+fn divideUnsigned(b: anytype, x: anytype, d: u64, w: u8) ?@TypeOf(x) {
+    if (d == 0) return null;
+    if (isPowerOfTwo(d)) return shr(b, x, @ctz(d), w);
+
+    const magic = magicUnsigned(d, w);
+    const t = mulhu(b, x, magic.m, w);
+    if (!magic.add) return shr(b, t, magic.shift, w);
+
+    // The magic needs w + 1 bits, the missing top bit is added back as x - t
+    const half = shr(b, b.binop(.sub, x, t), 1, w);
+    return shr(b, b.binop(.add, half, t), magic.shift - 1, w);
+}
+
+fn divideSigned(b: anytype, x: anytype, d: u64, w: u8) ?@TypeOf(x) {
+    const sd = signExtend(d, w);
+    // minInt / -1 has to trap like the instruction does. x / minInt is only
+    // ever 0 or 1, not worth a sequence
+    if (sd == 0 or sd == -1 or d == signBit(w)) return null;
+    if (sd == 1) return x;
+
+    const ad = @abs(sd);
+    if (isPowerOfTwo(ad)) {
+        // Negative dividends get 2^k - 1 added first so the shift rounds towards zero
+        const k: u32 = @ctz(ad);
+        const bias = shr(b, sar(b, x, w - 1, w), w - k, w);
+        const q = sar(b, b.binop(.add, x, bias), k, w);
+        return if (sd < 0) b.binop(.sub, b.constant(x, 0), q) else q;
+    }
+
+    const magic = magicSigned(sd, w);
+    var q = mulhs(b, x, magic.m, w);
+    const negative = signExtend(magic.m, w) < 0;
+    if (sd > 0 and negative) q = b.binop(.add, q, x);
+    if (sd < 0 and !negative) q = b.binop(.sub, q, x);
+    q = sar(b, q, magic.shift, w);
+
+    // The shift rounded negative quotients down, adding the sign bit rounds them up
+    return b.binop(.add, q, shr(b, q, w - 1, w));
+}
+
+// High half of the 2w bit product of x and m, both unsigned
+fn mulhu(b: anytype, x: anytype, m: u64, w: u8) @TypeOf(x) {
+    if (w <= 32) {
+        const wide = b.extend(x, false);
+        const product = b.binop(.mul, wide, b.constant(wide, m));
+        return b.truncate(shr(b, product, w, 64), x);
+    }
+
+    // No multiply-high in the builder, four 32 bit partial products instead
+    const half = b.constant(x, 0xffff_ffff);
+    const x0 = b.binop(.@"and", x, half);
+    const x1 = shr(b, x, 32, 64);
+    const m0 = b.constant(x, m & 0xffff_ffff);
+    const m1 = b.constant(x, m >> 32);
+
+    const t = b.binop(.add, b.binop(.mul, x1, m0), shr(b, b.binop(.mul, x0, m0), 32, 64));
+    const middle = b.binop(.add, b.binop(.mul, x0, m1), b.binop(.@"and", t, half));
+    const high = b.binop(.add, b.binop(.mul, x1, m1), shr(b, t, 32, 64));
+    return b.binop(.add, high, shr(b, middle, 32, 64));
+}
+
+// High half of the 2w bit product of x and m, both signed
+fn mulhs(b: anytype, x: anytype, m: u64, w: u8) @TypeOf(x) {
+    if (w <= 32) {
+        const wide = b.extend(x, true);
+        const product = b.binop(.mul, wide, b.constant(wide, @bitCast(signExtend(m, w))));
+        return b.truncate(sar(b, product, w, 64), x);
+    }
+
+    // The unsigned product counts a negative operand as 2^64 too much, once per operand
+    var high = mulhu(b, x, m, w);
+    high = b.binop(.sub, high, b.binop(.@"and", sar(b, x, 63, 64), b.constant(x, m)));
+    if (signExtend(m, w) < 0) high = b.binop(.sub, high, x);
+    return high;
+}
+
+fn shl(b: anytype, x: anytype, k: u32, w: u8) @TypeOf(x) {
+    std.debug.assert(k < w);
+    return if (k == 0) x else b.binop(.shl, x, b.constant(x, k));
+}
+
+fn shr(b: anytype, x: anytype, k: u32, w: u8) @TypeOf(x) {
+    std.debug.assert(k < w);
+    return if (k == 0) x else b.binop(.shr, x, b.constant(x, k));
+}
+
+fn sar(b: anytype, x: anytype, k: u32, w: u8) @TypeOf(x) {
+    std.debug.assert(k < w);
+    return if (k == 0) x else b.binop(.sar, x, b.constant(x, k));
+}
+
+const Magic = struct {
+    m: u64,
+    shift: u32,
+    // Unsigned only, the magic did not fit in w bits
+    add: bool = false,
+};
+
+// magicu2 of Hacker's Delight for w bit words, d is not a power of two
+fn magicUnsigned(d: u64, w: u8) Magic {
+    const all: u128 = mask(w);
+    const two = @as(u128, 1) << @intCast(w - 1);
+    const dd: u128 = d;
+
+    var add = false;
+    const nc = (all - ((0 -% dd) & all) % dd) & all;
+    var p: u32 = w - 1;
+    var q1 = two / nc;
+    var r1 = two - q1 * nc;
+    var q2 = (two - 1) / dd;
+    var r2 = (two - 1) - q2 * dd;
+
+    while (true) {
+        p += 1;
+        if (r1 >= (nc -% r1) & all) {
+            q1 = (2 * q1 + 1) & all;
+            r1 = (2 * r1 -% nc) & all;
+        } else {
+            q1 = (2 * q1) & all;
+            r1 = (2 * r1) & all;
+        }
+
+        if (r2 + 1 >= dd - r2) {
+            if (q2 >= two - 1) add = true;
+            q2 = (2 * q2 + 1) & all;
+            r2 = (2 * r2 + 1 -% dd) & all;
+        } else {
+            if (q2 >= two) add = true;
+            q2 = (2 * q2) & all;
+            r2 = (2 * r2 + 1) & all;
+        }
+
+        const delta = (dd -% 1 -% r2) & all;
+        if (!(p < 2 * @as(u32, w) and (q1 < delta or (q1 == delta and r1 == 0)))) break;
+    }
+
+    return .{ .m = @intCast((q2 + 1) & all), .shift = p - w, .add = add };
+}
+
+// magic of Hacker's Delight for w bit words, |d| is at least 3 and not a power of two
+fn magicSigned(d: i64, w: u8) Magic {
+    const two = @as(u128, 1) << @intCast(w - 1);
+    const ad: u128 = @abs(d);
+
+    const t = two + @intFromBool(d < 0);
+    const anc = t - 1 - t % ad;
+    var p: u32 = w - 1;
+    var q1 = two / anc;
+    var r1 = two - q1 * anc;
+    var q2 = two / ad;
+    var r2 = two - q2 * ad;
+
+    while (true) {
+        p += 1;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            q1 += 1;
+            r1 -= anc;
+        }
+
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            q2 += 1;
+            r2 -= ad;
+        }
+
+        const delta = ad - r2;
+        if (!(q1 < delta or (q1 == delta and r1 == 0))) break;
+    }
+
+    var m: u64 = @intCast((q2 + 1) & mask(w));
+    if (d < 0) m = (0 -% m) & mask(w);
+    return .{ .m = m, .shift = p - w };
+}
+
+fn mask(w: u8) u64 {
+    if (w >= 64) return std.math.maxInt(u64);
+    return (@as(u64, 1) << @intCast(w)) - 1;
+}
+
+fn signBit(w: u8) u64 {
+    return @as(u64, 1) << @intCast(w - 1);
+}
+
+fn signExtend(v: u64, w: u8) i64 {
+    const shift: u6 = @intCast(64 - @as(u32, w));
+    return @as(i64, @bitCast(v << shift)) >> shift;
+}
+
+fn isPowerOfTwo(v: u64) bool {
+    return v != 0 and v & (v - 1) == 0;
+}
+
+// Backend for the tests, values are bit patterns of their own width
+const Value = struct {
+    v: u64,
+    w: u8,
+};
+
+const Eval = struct {
+    fn constant(_: @This(), like: Value, v: u64) Value {
+        return .{ .v = v & mask(like.w), .w = like.w };
+    }
+
+    fn binop(_: @This(), op: Op, a: Value, c: Value) Value {
+        std.debug.assert(a.w == c.w);
+        const r = switch (op) {
+            .add => a.v +% c.v,
+            .sub => a.v -% c.v,
+            .mul => a.v *% c.v,
+            .@"and" => a.v & c.v,
+            .shl => a.v << @intCast(c.v),
+            .shr => a.v >> @intCast(c.v),
+            .sar => @as(u64, @bitCast(signExtend(a.v, a.w) >> @intCast(c.v))),
+        };
+        return .{ .v = r & mask(a.w), .w = a.w };
+    }
+
+    fn extend(_: @This(), x: Value, signed: bool) Value {
+        return .{ .v = if (signed) @bitCast(signExtend(x.v, x.w)) else x.v, .w = 64 };
+    }
+
+    fn truncate(_: @This(), x: Value, like: Value) Value {
+        return .{ .v = x.v & mask(like.w), .w = like.w };
+    }
+};
+
+fn expectReduced(w: u8, x: u64, c: u64) !void {
+    const e = Eval{};
+    const value = Value{ .v = x, .w = w };
+    const sx = signExtend(x, w);
+    const sc = signExtend(c, w);
+
+    if (multiply(e, value, c, w)) |r| try std.testing.expectEqual((x *% c) & mask(w), r.v);
+    if (c == 0) return;
+
+    if (divide(e, value, c, w, false)) |r| try std.testing.expectEqual(x / c, r.v);
+    if (modulo(e, value, c, w, false)) |r| try std.testing.expectEqual(x % c, r.v);
+
+    if (sc == -1) return;
+    if (divide(e, value, c, w, true)) |r| try std.testing.expectEqual(@as(u64, @bitCast(@divTrunc(sx, sc))) & mask(w), r.v);
+    if (modulo(e, value, c, w, true)) |r| try std.testing.expectEqual(@as(u64, @bitCast(@rem(sx, sc))) & mask(w), r.v);
+}
+
+test "every 8 bit dividend by every 8 bit constant" {
+    for (0..256) |c| {
+        for (0..256) |x| try expectReduced(8, x, c);
+    }
+}
+
+test "every 16 bit dividend by small, large and spread constants" {
+    var constants = std.BoundedArray(u64, 256).init(0) catch unreachable;
+    for (0..33) |c| constants.appendAssumeCapacity(c);
+    for (65528..65536) |c| constants.appendAssumeCapacity(c);
+    var c: u64 = 37;
+    while (c < 65528) : (c += 997) constants.appendAssumeCapacity(c);
+    for ([_]u64{ 641, 1000, 32767, 32768, 32769, 43690 }) |k| constants.appendAssumeCapacity(k);
+
+    for (constants.constSlice()) |k| {
+        for (0..65536) |x| try expectReduced(16, x, k);
+    }
+}
+
+test "32 and 64 bit edge dividends" {
+    const constants = [_]u64{ 3, 5, 6, 7, 10, 641, 1000, 0x7fff_ffff, 0x8000_0001, 0xffff_fffe, 0x1_0000_0001, 0x7fff_ffff_ffff_ffff, 0xffff_ffff_ffff_fffd };
+    const dividends = [_]u64{ 0, 1, 2, 99, 0x7fff_ffff, 0x8000_0000, 0xffff_ffff, 0x1234_5678_9abc_def0, 0x7fff_ffff_ffff_ffff, 0x8000_0000_0000_0000, 0xffff_ffff_ffff_ffff };
+
+    for ([_]u8{ 32, 64 }) |w| {
+        for (constants) |c| {
+            for (dividends) |x| try expectReduced(w, x & mask(w), c & mask(w));
+        }
+    }
+}
@@ -23,6 +23,15 @@ pub fn getType(t: Primitive) tb.DataType {
     };
 }
 
+// A variable read inside an expression of another width, narrower values are
+// extended by the signedness of the variable
+pub fn resize(g: tb.GraphBuilder, v: *tb.Node, from: Primitive, to: Primitive) *tb.Node {
+    if (from.size == to.size or from.type == .float or to.type == .float) return v;
+    if (from.size > to.size) return g.cast(getType(to), tb.NodeType.TRUNCATE, v);
+
+    return g.cast(getType(to), if (from.type == .signed) tb.NodeType.SIGN_EXT else tb.NodeType.ZERO_EXT, v);
+}
+
 pub fn getDebugType(m: tb.Module, t: Primitive) ?*tb.DebugType {
     return switch (t.type) {
         .bool => m.debugGetBool(),
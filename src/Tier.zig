@@ -0,0 +1,124 @@
+const std = @import("std");
+const Logger = @import("Logger.zig");
+
+const IR = @import("IR/IR.zig");
+const Jit = @import("Jit.zig");
+const Overflow = @import("ParseArgs.zig").Overflow;
+
+const tb = @import("libs/tb/tb.zig");
+
+// Tiered JIT of run -tiered. Tier 0 is what the normal codegen placed, built
+// without tb_opt and bumping a counter on entry. Once main has been called
+// threshold times a background thread builds it again at -O2 into a new
+// function, places it and swaps the entry, so the calls after that run the
+// optimized code. The thread only touches TB and the JIT while the main thread
+// is calling main, which uses neither
+const State = enum(u8) { tier0, compiling, done };
+
+const Main = *const fn () u8;
+
+f: IR.Function,
+m: tb.Module,
+jit: *Jit,
+overflow: Overflow,
+features: tb.FeatureSet,
+// Written by the tier 0 code itself
+calls: *const u64,
+threshold: u64,
+entry: std.atomic.Value(Main),
+tier0: Main,
+state: std.atomic.Value(State) = std.atomic.Value(State).init(.tier0),
+thread: ?std.Thread = null,
+name: []u8 = &.{},
+
+// Calls made and time spent in each tier, and what the rebuild cost off the main thread
+tierCalls: [2]u64 = .{ 0, 0 },
+tierNs: [2]u64 = .{ 0, 0 },
+tierUpAt: u64 = 0,
+compileNs: u64 = 0,
+
+const alloc = std.heap.page_allocator;
+
+pub fn init(f: IR.Function, m: tb.Module, jit: *Jit, overflow: Overflow, features: tb.FeatureSet, tier0: Main, calls: *const u64, threshold: u64) @This() {
+    return @This(){
+        .f = f,
+        .m = m,
+        .jit = jit,
+        .overflow = overflow,
+        .features = features,
+        .calls = calls,
+        .threshold = threshold,
+        .entry = std.atomic.Value(Main).init(tier0),
+        .tier0 = tier0,
+    };
+}
+
+pub fn deinit(self: *@This()) void {
+    if (self.thread) |t| t.join();
+    alloc.free(self.name);
+}
+
+pub fn call(self: *@This()) u8 {
+    const f = self.entry.load(.acquire);
+    const tier = @intFromBool(f != self.tier0);
+
+    var timer = std.time.Timer.start() catch unreachable;
+    const r = f();
+    self.tierNs[tier] += timer.read();
+    self.tierCalls[tier] += 1;
+
+    if (self.state.load(.acquire) == .tier0 and self.calls.* >= self.threshold) {
+        self.tierUpAt = self.calls.*;
+        self.state.store(.compiling, .monotonic);
+        self.thread = std.Thread.spawn(.{}, tierUp, .{self}) catch {
+            // Stays in tier 0 for good
+            self.state.store(.done, .monotonic);
+            return r;
+        };
+    }
+
+    return r;
+}
+
+fn tierUp(self: *@This()) void {
+    var timer = std.time.Timer.start() catch unreachable;
+
+    const ws = tb.Worklist.alloc();
+    defer ws.free();
+    var arena: tb.Arena = undefined;
+    tb.Arena.create(&arena, "Tier 1");
+    defer arena.destroy();
+
+    self.name = std.fmt.allocPrint(alloc, "{s}.tier1", .{self.f.name}) catch return;
+    const func = self.m.functionCreate(self.name, tb.Linkage.PRIVATE);
+    _ = self.f.build(alloc, self.m, func, ws, self.overflow, null) catch return;
+    while (func.opt(ws, false)) {}
+
+    const out = func.codeGen(ws, &arena, &self.features, false);
+    const code = self.jit.place(.{ .id = self.f.id, .tier = 1 }, func, out.getCode().len) catch return;
+
+    self.compileNs = timer.read();
+    if (code) |c| self.entry.store(@ptrCast(c), .release);
+    self.state.store(.done, .release);
+}
+
+// Waits for the rebuild, the run can end while it is still going
+pub fn report(self: *@This()) void {
+    if (self.thread) |t| t.join();
+    self.thread = null;
+
+    if (self.tierUpAt == 0) {
+        Logger.log.info("{s} stayed in tier 0, {} calls in {}", .{ self.f.name, self.tierCalls[0], std.fmt.fmtDuration(self.tierNs[0]) });
+        return;
+    }
+
+    Logger.log.info("{s} tiered up after {} calls, rebuilt at -O2 in {} off the main thread", .{ self.f.name, self.tierUpAt, std.fmt.fmtDuration(self.compileNs) });
+    for (0..2) |t| {
+        Logger.log.info("Tier {} {} calls in {} ({} per call)", .{
+            t,
+            self.tierCalls[t],
+            std.fmt.fmtDuration(self.tierNs[t]),
+            std.fmt.fmtDuration(self.tierNs[t] / @max(self.tierCalls[t], 1)),
+        });
+    }
+}
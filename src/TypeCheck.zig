@@ -5,10 +5,24 @@ const Parser = @import("./Parser/Parser.zig");
 const Program = Parser.Program;
 const Primitive = Parser.Primitive;
 const Function = Parser.StatementFunc;
+const Expression = Parser.Expression;
+const Ast = Parser.Ast;
 
-pub fn typeCheck(p: Program) !bool {
+// Every file of the build, main has to be in one of them. Also annotates the
+// expressions: every node gets its type and literals are decoded once
+pub fn typeCheck(programs: []const *Program) !bool {
     var err = false;
-    if (p.funcs.get("main") == null) {
+    var hasMain = false;
+    for (programs) |p| {
+        if (p.lookup("main") != null) hasMain = true;
+
+        if (p.lookup("_start")) |startF| {
+            err = true;
+            Logger.logLocation.err(startF.loc, "identifier _start is not available", .{});
+        }
+    }
+
+    if (!hasMain) {
         err = true;
         Logger.log.err(
             \\Main function must be defined 
@@ -18,14 +32,17 @@ pub fn typeCheck(p: Program) !bool {
         , .{});
     }
 
-    if (p.funcs.get("_start")) |startF| {
-        err = true;
-        Logger.logLocation.err(startF.loc, "identifier _start is not available", .{});
+    for (programs) |p| {
+        if (try checkProgram(p)) err = true;
     }
 
-    var itFunc = p.funcs.iterator();
-    while (itFunc.next()) |func| {
-        const retType = func.value_ptr.returnType;
+    return err;
+}
+
+fn checkProgram(p: *Program) !bool {
+    var err = false;
+    for (p.funcs.items) |func| {
+        const retType = func.returnType;
         if (retType.type != .bool or retType.type != .void) {
             if ((retType.type == .signed or retType.type == .unsigned) and retType.size % 8 != 0 and retType.size <= 64) {
                 err = true;
@@ -37,11 +54,13 @@ pub fn typeCheck(p: Program) !bool {
                 continue;
             }
         }
-        for (func.value_ptr.body.items) |stmt| {
+        for (func.body.items) |stmt| {
             switch (stmt) {
-                .ret => |ret| if (!retType.possibleValue(ret.expr)) {
+                .ret => |ret| if (!annotate(&p.ast, ret.expr, retType, false)) {
+                    err = true;
+                },
+                .let => |let| if (!annotate(&p.ast, let.expr, let.t, false)) {
                     err = true;
-                    Logger.log.err("Rework Type Errors", .{});
                 },
                 else => continue,
             }
@@ -50,3 +69,38 @@ pub fn typeCheck(p: Program) !bool {
 
     return err;
 }
+
+// There are no casts yet, every node of an expression has the type it is assigned to
+fn annotate(ast: *Ast, e: Expression, ty: Primitive, negated: bool) bool {
+    ast.setType(e, ty);
+
+    switch (ast.tag(e)) {
+        .leaf => {
+            const v = std.fmt.parseUnsigned(u64, ast.str(e), 10) catch {
+                Logger.logLocation.err(ast.loc(e), "Literal {s} does not fit in 64 bits", .{ast.str(e)});
+                return false;
+            };
+            if (!ty.possibleValue(v, negated)) {
+                Logger.logLocation.err(ast.loc(e), "Literal {s} does not fit in {s}{}", .{ ast.str(e), @tagName(ty.type), ty.size });
+                return false;
+            }
+
+            ast.setConstant(e, if (ty.type == .float) @bitCast(@as(f64, @floatFromInt(v))) else v);
+            return true;
+        },
+        .constant, .variable => return true,
+        .paren => return annotate(ast, ast.lhs(e), ty, negated),
+        .una => return annotate(ast, ast.lhs(e), ty, !negated),
+        .bin => {
+            const op = ast.str(e)[0];
+            if (ty.type == .float and (op == '%' or op == '^')) {
+                Logger.logLocation.err(ast.loc(e), "Operator {c} is not defined for floats", .{op});
+                return false;
+            }
+
+            const left = annotate(ast, ast.lhs(e), ty, false);
+            const right = annotate(ast, ast.rhs(e), ty, false);
+            return left and right;
+        },
+    }
+}
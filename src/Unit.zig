@@ -0,0 +1,156 @@
+const std = @import("std");
+const Logger = @import("Logger.zig");
+
+const Lexer = @import("./Lexer/Lexer.zig");
+const Parser = @import("./Parser/Parser.zig");
+const CountingAllocator = @import("./Util/CountingAllocator.zig");
+
+// One source file. Lexed and parsed on a pool worker with its own arena, nothing
+// is shared with the other units until the function tables are merged into the IR
+pub const State = enum {
+    pending,
+    couldNotLex,
+    outOfMemory,
+    unexpectedToken,
+    ok,
+};
+
+path: []const u8,
+arena: std.heap.ArenaAllocator,
+counting: CountingAllocator,
+lexer: Lexer,
+parser: Parser,
+state: State = .pending,
+hasLexer: bool = false,
+hasParser: bool = false,
+
+firstTokenNs: u64 = 0,
+lexNs: u64 = 0,
+parseNs: u64 = 0,
+parseAllocs: u64 = 0,
+parseResizes: u64 = 0,
+parseBytes: u64 = 0,
+
+// Units are pointed to by their lexer and parser, so they are built in place
+pub fn init(self: *@This(), path: []const u8) void {
+    self.* = .{
+        .path = path,
+        .arena = std.heap.ArenaAllocator.init(std.heap.page_allocator),
+        .counting = undefined,
+        .lexer = undefined,
+        .parser = undefined,
+    };
+    self.counting = CountingAllocator.init(self.arena.allocator());
+}
+
+pub fn deinit(self: *@This()) void {
+    if (self.hasParser) self.parser.deinit();
+    if (self.hasLexer) self.lexer.deinit();
+    self.arena.deinit();
+}
+
+pub fn run(self: *@This(), useMmap: bool, parse: bool, bench: bool) void {
+    const alloc = self.counting.allocator();
+    var timer = std.time.Timer.start() catch unreachable;
+
+    self.lexer = Lexer.lex(alloc, self.path, useMmap) orelse {
+        self.state = .couldNotLex;
+        return;
+    };
+    self.hasLexer = true;
+
+    if (bench) {
+        var first = self.lexer;
+        _ = first.advance();
+        self.firstTokenNs = timer.read();
+    }
+
+    self.lexer.tokenize() catch {
+        self.state = .outOfMemory;
+        return;
+    };
+    self.lexNs = timer.lap();
+    self.state = .ok;
+
+    if (!parse) return;
+
+    const before = self.counting;
+    self.parser = Parser.init(alloc, &self.lexer);
+    self.hasParser = true;
+    self.parser.parse() catch |err| switch (err) {
+        error.OutOfMemory => self.state = .outOfMemory,
+        error.UnexpectedToken => self.state = .unexpectedToken,
+    };
+
+    self.parseNs = timer.lap();
+    self.parseAllocs = self.counting.allocs - before.allocs;
+    self.parseResizes = self.counting.resizes - before.resizes;
+    self.parseBytes = self.counting.bytes - before.bytes;
+}
+
+// Lexes and parses every unit, one pool task per file. serve passes the pool
+// it keeps, otherwise one is started for the call
+pub fn runAll(units: []@This(), useMmap: bool, parse: bool, bench: bool, shared: ?*std.Thread.Pool) void {
+    if (units.len == 1) return units[0].run(useMmap, parse, bench);
+
+    if (shared) |pool| {
+        var wg = std.Thread.WaitGroup{};
+        for (units) |*u| {
+            wg.start();
+            pool.spawn(runGroup, .{ u, useMmap, parse, bench, &wg }) catch {
+                wg.finish();
+                u.run(useMmap, parse, bench);
+            };
+        }
+        wg.wait();
+        return;
+    }
+
+    var pool: std.Thread.Pool = undefined;
+    pool.init(.{ .allocator = std.heap.page_allocator }) catch {
+        for (units) |*u| u.run(useMmap, parse, bench);
+        return;
+    };
+    // Workers drain the queue before deinit joins them
+    defer pool.deinit();
+
+    for (units) |*u| {
+        pool.spawn(run, .{ u, useMmap, parse, bench }) catch u.run(useMmap, parse, bench);
+    }
+}
+
+fn runGroup(self: *@This(), useMmap: bool, parse: bool, bench: bool, wg: *std.Thread.WaitGroup) void {
+    defer wg.finish();
+    self.run(useMmap, parse, bench);
+}
+
+// Directories are expanded to the .yt files under them, sorted so the build
+// order, and with it the diagnostics, does not depend on the file system
+pub fn sources(alloc: std.mem.Allocator, paths: []const []const u8) ![]const []const u8 {
+    var result = std.ArrayList([]const u8).init(alloc);
+
+    for (paths) |path| {
+        var dir = std.fs.cwd().openDir(path, .{ .iterate = true }) catch {
+            try result.append(path);
+            continue;
+        };
+        defer dir.close();
+
+        const start = result.items.len;
+        var walker = try dir.walk(alloc);
+        defer walker.deinit();
+
+        while (try walker.next()) |entry| {
+            if (entry.kind != .file or !std.mem.endsWith(u8, entry.basename, ".yt")) continue;
+            try result.append(try std.fs.path.join(alloc, &.{ path, entry.path }));
+        }
+
+        std.mem.sort([]const u8, result.items[start..], {}, lessThan);
+    }
+
+    return result.toOwnedSlice();
+}
+
+fn lessThan(_: void, a: []const u8, b: []const u8) bool {
+    return std.mem.lessThan(u8, a, b);
+}
@@ -0,0 +1,46 @@
+const std = @import("std");
+const Allocator = std.mem.Allocator;
+
+// Forwards to the child allocator and counts the requests, used by -b
+child: Allocator,
+allocs: u64 = 0,
+resizes: u64 = 0,
+bytes: u64 = 0,
+
+pub fn init(child: Allocator) @This() {
+    return @This(){
+        .child = child,
+    };
+}
+
+pub fn allocator(self: *@This()) Allocator {
+    return Allocator{
+        .ptr = self,
+        .vtable = &.{
+            .alloc = alloc,
+            .resize = resize,
+            .free = free,
+        },
+    };
+}
+
+fn alloc(ctx: *anyopaque, len: usize, ptrAlign: u8, retAddr: usize) ?[*]u8 {
+    const self: *@This() = @ptrCast(@alignCast(ctx));
+    const result = self.child.rawAlloc(len, ptrAlign, retAddr) orelse return null;
+    self.allocs += 1;
+    self.bytes += len;
+    return result;
+}
+
+fn resize(ctx: *anyopaque, buf: []u8, bufAlign: u8, newLen: usize, retAddr: usize) bool {
+    const self: *@This() = @ptrCast(@alignCast(ctx));
+    if (!self.child.rawResize(buf, bufAlign, newLen, retAddr)) return false;
+    self.resizes += 1;
+    if (newLen > buf.len) self.bytes += newLen - buf.len;
+    return true;
+}
+
+fn free(ctx: *anyopaque, buf: []u8, bufAlign: u8, retAddr: usize) void {
+    const self: *@This() = @ptrCast(@alignCast(ctx));
+    self.child.rawFree(buf, bufAlign, retAddr);
+}
@@ -2,6 +2,8 @@ const cc = @cImport({
     @cInclude("stdio.h");
 });
 
+const std = @import("std");
+
 const tb = @import("./tbHeader.zig");
 
 pub const Arch = tb.Arch;
@@ -18,8 +20,13 @@ pub const DataType = tb.DataType;
 pub const Node = tb.Node;
 pub const ExternalType = tb.ExternalType;
 pub const Symbol = tb.Symbol;
+pub const Global = tb.Global;
+pub const ModuleSectionFlags = tb.ModuleSectionFlags;
+pub const ComdatType = tb.ComdatType;
 pub const FeatureSet = tb.FeatureSet;
+pub const FeatureSetX64 = tb.FeatureSet_X64;
 pub const CharUnits = tb.CharUnits;
+pub const Assembly = tb.Assembly;
 
 pub const NodeType = tb.NodeTypeEnum;
 pub const ArithmeticBehavior = tb.ArithmeticBehavior;
@@ -111,6 +118,23 @@ pub const Module = struct {
         return tb.moduleGetTLS(self.m);
     }
 
+    pub inline fn createSection(self: @This(), name: []const u8, flags: ModuleSectionFlags, comdat: ComdatType) ModuleSectionHandle {
+        return tb.moduleCreateSection(self.m, @intCast(name.len), name.ptr, flags, comdat);
+    }
+
+    pub inline fn globalCreate(self: @This(), name: []const u8, linkage: Linkage) *Global {
+        return tb.globalCreate(self.m, @intCast(name.len), name.ptr, null, linkage) orelse unreachable;
+    }
+
+    pub inline fn globalSetStorage(self: @This(), section: ModuleSectionHandle, g: *Global, size: usize, a: usize, maxObjects: usize) void {
+        tb.globalSetStorage(self.m, section, g, size, a, maxObjects);
+    }
+
+    pub inline fn globalAddRegion(self: @This(), g: *Global, offset: usize, size: usize) []u8 {
+        const region: [*]u8 = @ptrCast(tb.globalAddRegion(self.m, g, offset, size) orelse unreachable);
+        return region[0..size];
+    }
+
     pub inline fn createPrototype(self: @This(), c: CallingConv, paramCount: usize, params: [*c]PrototypeParam, returnCount: usize, returns: [*c]PrototypeParam, hasVarArgs: bool) *FunctionPrototype {
         return tb.prototypeCreate(self.m, c, paramCount, params, returnCount, returns, hasVarArgs);
     }
@@ -149,7 +173,7 @@ pub const Function = struct {
         return GraphBuilder.enter(self, section, proto, ws);
     }
 
-    pub inline fn codeGen(self: @This(), ws: ?Worklist, a: ?*Arena, f: *FeatureSet, emit_asm: bool) FunctionOutput {
+    pub inline fn codeGen(self: @This(), ws: ?Worklist, a: ?*Arena, f: *const FeatureSet, emit_asm: bool) FunctionOutput {
         const out = tb.codegen(self.f, if (ws) |w| w.ws else null, if (a) |arena| &arena.arena else null, f, emit_asm) orelse unreachable;
 
         return FunctionOutput{ .fo = out };
@@ -159,6 +183,25 @@ pub const Function = struct {
         return tb.opt(self.f, if (ws) |w| w.ws else null, perserve_types);
     }
 
+    // Live nodes of the graph, walked from the root along both edge directions
+    pub fn nodeCount(self: @This(), alloc: std.mem.Allocator) std.mem.Allocator.Error!usize {
+        var seen = std.AutoHashMap(*Node, void).init(alloc);
+        defer seen.deinit();
+        var stack = std.ArrayList(*Node).init(alloc);
+        defer stack.deinit();
+
+        try stack.append(tb.instRootNode(self.f) orelse return 0);
+        while (stack.popOrNull()) |n| {
+            if ((try seen.getOrPut(n)).found_existing) continue;
+
+            for (0..n.input_count) |i| if (n.inputs[i]) |in| try stack.append(in);
+            const users: [*]const tb.User = @ptrCast(n.users orelse continue);
+            for (users[0..n.user_count]) |u| try stack.append(@ptrFromInt(@as(usize, u._n)));
+        }
+
+        return seen.count();
+    }
+
     pub inline fn print(self: @This()) void {
         tb.print(self.f);
     }
@@ -170,9 +213,11 @@ pub const Function = struct {
 
 pub const GraphBuilder = struct {
     g: *tb.GraphBuilder,
+    // Function being built, for the tb_inst calls the builder has no version of
+    f: *tb.Function,
 
     pub inline fn enter(f: Function, section: ModuleSectionHandle, proto: *FunctionPrototype, ws: ?Worklist) @This() {
-        return @This(){ .g = tb.builderEnter(f.f, section, proto, if (ws) |w| w.ws else null) orelse unreachable };
+        return @This(){ .g = tb.builderEnter(f.f, section, proto, if (ws) |w| w.ws else null) orelse unreachable, .f = f.f };
     }
 
     pub inline fn exit(self: @This()) void {
@@ -199,10 +244,22 @@ pub const GraphBuilder = struct {
         return tb.builderSint(self.g, dt, x) orelse unreachable;
     }
 
+    pub inline fn float32(self: @This(), x: f32) *Node {
+        return tb.builderFloat32(self.g, x) orelse unreachable;
+    }
+
+    pub inline fn float64(self: @This(), x: f64) *Node {
+        return tb.builderFloat64(self.g, x) orelse unreachable;
+    }
+
     pub inline fn binopInt(self: @This(), t: NodeType, a: *Node, b: *Node, ab: ArithmeticBehavior) *Node {
         return tb.builderBinopInt(self.g, @intFromEnum(t), a, b, ab) orelse unreachable;
     }
 
+    pub inline fn binopFloat(self: @This(), t: NodeType, a: *Node, b: *Node) *Node {
+        return tb.builderBinopFloat(self.g, @intFromEnum(t), a, b) orelse unreachable;
+    }
+
     pub inline fn ret(self: @This(), mem_var: i32, arg_count: i32, args: [*c]?*Node) void {
         return tb.builderRet(self.g, mem_var, arg_count, args);
     }
@@ -219,6 +276,25 @@ pub const GraphBuilder = struct {
         tb.builderIf(self.g, cond, @ptrCast(&paths[0]));
     }
 
+    // Like if, but the true path is marked as never taken so codegen lays it
+    // out after the hot code
+    pub fn ifCold(self: @This(), cond: *Node, paths: *[2]*Node) void {
+        self.@"if"(cond, paths);
+
+        // The labels builderIf returns hang off the projections of the branch,
+        // following the control inputs up from one of them always reaches it
+        var n: *Node = paths[0];
+        while (n.type != @intFromEnum(NodeType.BRANCH)) {
+            std.debug.assert(n.input_count > 0);
+            n = n.inputs[0].?;
+        }
+        tb.instSetBranchFreq(self.f, n, 100, 0);
+    }
+
+    pub inline fn trap(self: @This(), mem_var: i32) void {
+        tb.builderTrap(self.g, mem_var);
+    }
+
     pub inline fn loop(self: @This()) *Node {
         return tb.builderLoop(self.g) orelse unreachable;
     }
@@ -251,10 +327,34 @@ pub const GraphBuilder = struct {
         return tb.builderLoad(self.g, mem_var, ctrlDep, dt, addr, a, isVolatile) orelse unreachable;
     }
 
+    pub inline fn labelGet(self: @This()) *Node {
+        return tb.builderLabelGet(self.g) orelse unreachable;
+    }
+
+    pub inline fn decl(self: @This(), label: *Node) c_int {
+        return tb.builderDecl(self.g, label);
+    }
+
+    pub inline fn getVar(self: @This(), id: c_int) *Node {
+        return tb.builderGetVar(self.g, id) orelse unreachable;
+    }
+
+    pub inline fn setVar(self: @This(), id: c_int, v: *Node) void {
+        tb.builderSetVar(self.g, id, v);
+    }
+
+    pub inline fn cast(self: @This(), dt: DataType, t: NodeType, src: *Node) *Node {
+        return tb.builderCast(self.g, dt, @intFromEnum(t), src) orelse unreachable;
+    }
+
     pub inline fn br(self: @This(), label: *Node) void {
         tb.builderBr(self.g, label);
     }
 
+    pub inline fn select(self: @This(), cond: *Node, a: *Node, b: *Node) *Node {
+        return tb.builderSelect(self.g, cond, a, b) orelse unreachable;
+    }
+
     pub inline fn cmp(self: @This(), t: NodeType, a: *Node, b: *Node) *Node {
         return tb.builderCmp(self.g, @intFromEnum(t), a, b) orelse unreachable;
     }
@@ -279,6 +379,17 @@ pub const FunctionOutput = struct {
     pub inline fn printAsm(self: @This(), f: *cc.FILE) void {
         tb.outputPrintAsm(self.fo, f);
     }
+
+    pub inline fn getCode(self: @This()) []const u8 {
+        var len: usize = 0;
+        const code = tb.outputGetCode(self.fo, &len);
+        return code[0..len];
+    }
+
+    // Chunks of the listing, null unless codegen ran with emit_asm
+    pub inline fn getAsm(self: @This()) ?*Assembly {
+        return tb.outputGetAsm(self.fo);
+    }
 };
 
 pub const ExportBuffer = struct {
@@ -287,6 +398,17 @@ pub const ExportBuffer = struct {
     pub inline fn toFile(self: @This(), path: [:0]const u8) bool {
         return tb.exportBufferToFile(self.eb, @as([*c]const u8, path.ptr));
     }
+
+    // The chunks copied into one contiguous object
+    pub fn toSlice(self: @This(), alloc: std.mem.Allocator) std.mem.Allocator.Error![]u8 {
+        const buf = try alloc.alloc(u8, self.eb.total);
+        var chunk: ?*tb.ExportChunk = self.eb.head;
+        while (chunk) |c| : (chunk = c.next) {
+            @memcpy(buf[c.pos..][0..c.size], c.data()[0..c.size]);
+        }
+
+        return buf;
+    }
 };
 
 pub const Jit = struct {
@@ -303,4 +425,16 @@ pub const Jit = struct {
     pub inline fn placeFunction(self: @This(), f: Function) ?*anyopaque {
         return tb.jitPlanceFunction(self.jit, f.f);
     }
+
+    pub inline fn freeObj(self: @This(), ptr: *anyopaque) void {
+        tb.jitFreeObj(self.jit, ptr);
+    }
+
+    pub inline fn dumpHeap(self: @This()) void {
+        tb.jitDumpHeap(self.jit);
+    }
+
+    pub inline fn end(self: @This()) void {
+        tb.jitEnd(self.jit);
+    }
 };
@@ -4,32 +4,56 @@ const util = @import("Util.zig");
 const Lexer = @import("./Lexer/Lexer.zig");
 const ParseArguments = @import("ParseArgs.zig");
 const typeCheck = @import("TypeCheck.zig").typeCheck;
+const ConstantFold = @import("ConstantFold.zig");
 
 const usage = @import("General.zig").usage;
 
 const Result = util.Result;
-const Commnad = @import("./Util/Command.zig");
+const Unit = @import("Unit.zig");
+const Cache = @import("Cache.zig");
+const Elf = @import("Elf.zig");
+const Jit = @import("Jit.zig");
+const Tier = @import("Tier.zig");
+const March = @import("March.zig");
+const Session = @import("Session.zig");
+const Serve = @import("Serve.zig");
+const CodeGen = @import("CodeGen.zig");
+const Asm = @import("Asm.zig");
+const Sim = @import("./Sim/Sim.zig");
 
 const getArguments = ParseArguments.getArguments;
 const Arguments = ParseArguments.Arguments;
-const lex = Lexer.lex;
 const Parser = @import("./Parser/Parser.zig");
 const IR = @import("IR/IR.zig");
 
 const tb = @import("./libs/tb/tb.zig");
 
+// Traps of the generated code belong to the program, not to a crash of the
+// compiler. Without the handler they end the process with the plain signal like
+// the executables build writes, so the examples can expect them
+pub const std_options: std.Options = .{ .enable_segfault_handler = false };
+
+test {
+    _ = @import("StrengthReduce.zig");
+    _ = Asm;
+    _ = Cache;
+    _ = March;
+    _ = Serve;
+}
+
 fn getName(absPath: []const u8, extName: []const u8) []u8 {
     var buf: [5 * 1024]u8 = undefined;
 
-    const fileName = std.mem.lastIndexOf(u8, absPath, "/").?;
-    const ext = std.mem.lastIndexOf(u8, absPath, ".").?;
+    // stdin has neither directory nor extension
+    const fileName = if (std.mem.lastIndexOf(u8, absPath, "/")) |i| i + 1 else 0;
+    const ext = std.mem.lastIndexOf(u8, absPath, ".") orelse absPath.len;
     if (extName.len > 0)
-        return std.fmt.bufPrint(&buf, "{s}.{s}", .{ absPath[fileName + 1 .. ext], extName }) catch {
+        return std.fmt.bufPrint(&buf, "{s}.{s}", .{ absPath[fileName..ext], extName }) catch {
             Logger.log.err("Name is to larger than {}\n", .{5 * 1024});
             return "";
         }
     else
-        return @constCast(absPath[fileName + 1 .. ext]);
+        return @constCast(absPath[fileName..ext]);
 }
 
 fn writeAll(c: []const u8, arg: Arguments, name: []u8) void {
@@ -44,7 +68,7 @@ fn writeAll(c: []const u8, arg: Arguments, name: []u8) void {
         writer = std.io.getStdOut().writer();
     } else {
         file = std.fs.cwd().createFile(name, .{}) catch |err| {
-            Logger.log.err("could not open file ({s}) becuase {}\n", .{ arg.path, err });
+            Logger.log.err("could not open file ({s}) becuase {}\n", .{ name, err });
             return;
         };
 
@@ -52,40 +76,116 @@ fn writeAll(c: []const u8, arg: Arguments, name: []u8) void {
     }
 
     writer.writeAll(c) catch |err| {
-        Logger.log.err("Could not write to file ({s}) becuase {}\n", .{ arg.path, err });
+        Logger.log.err("Could not write to file ({s}) becuase {}\n", .{ name, err });
         return;
     };
 }
 
-fn generateExecutable(alloc: std.mem.Allocator, m: tb.Module, a: *tb.Arena, path: []const u8) u8 {
+// Linked in memory, the object never touches the disk
+fn generateExecutable(alloc: std.mem.Allocator, m: tb.Module, a: *tb.Arena, path: []const u8, bench: bool) u8 {
+    var timer = std.time.Timer.start() catch unreachable;
+
     const eb = m.objectExport(a, tb.DebugFormat.NONE);
-    if (!eb.toFile(("mainModule.o"))) {
-        Logger.log.err("Could not export object to file", .{});
+    const object = eb.toSlice(alloc) catch {
+        Logger.log.err("Out of memory", .{});
         return 1;
-    }
+    };
+    defer alloc.free(object);
 
-    var cmdObj = Commnad.init(alloc, &[_][]const u8{ "ld", "mainModule.o", "-o", path }, false);
-    const resultObj = cmdObj.execute() catch {
-        Logger.log.err("Could not link the generated object file", .{});
+    const size = Elf.link(alloc, object, path) catch |err| {
+        Logger.log.err("Could not link {s} because {}", .{ path, err });
         return 1;
     };
 
-    var cmdClean = Commnad.init(alloc, &[_][]const u8{ "rm", "mainModule.o" }, false);
-    _ = cmdClean.execute() catch {
-        Logger.log.err("Could not clean the generated object file", .{});
-    };
+    if (bench) Logger.log.info("Linked {s} ({} bytes) in {}", .{ path, size, std.fmt.fmtDuration(timer.read()) });
+    return 0;
+}
 
-    switch (resultObj) {
-        .Exited => |x| if (x != 0) Logger.log.err("Could not link generated object file", .{}),
-        else => Logger.log.err("Could not link generated object file", .{}),
+fn benchLexer(units: []const Unit, ns: u64) void {
+    var bytes: f64 = 0;
+    var tokens: usize = 0;
+    var firstToken: u64 = 0;
+    for (units) |u| {
+        if (!u.hasLexer) continue;
+        bytes += @floatFromInt(u.lexer.content.len);
+        tokens += u.lexer.tokens.len;
+        firstToken = @max(firstToken, u.firstTokenNs);
     }
 
-    return 0;
+    const mbs = bytes * std.time.ns_per_s / @as(f64, @floatFromInt(@max(ns, 1))) / (1024 * 1024);
+    Logger.log.info("Time to first token {} ({s})", .{
+        std.fmt.fmtDuration(firstToken),
+        if (units[0].hasLexer and units[0].lexer.mapped != null) "mmap" else "read",
+    });
+    Logger.log.info("Lexer throughput {d:.2} MB/s ({} tokens, {} files in {})", .{ mbs, tokens, units.len, std.fmt.fmtDuration(ns) });
 }
 
-pub fn main() u8 {
+// Same program on both tiers, the JIT startup includes building the TB graphs and codegen
+fn compareTiers(sim: Sim.Result, jitStartupNs: u64, entry: anytype) void {
     var timer = std.time.Timer.start() catch unreachable;
+    for (0..Sim.benchRuns) |_| {
+        std.mem.doNotOptimizeAway(entry.call());
+    }
+    const jitRunNs = timer.read() / Sim.benchRuns;
+
+    Logger.log.info("JIT startup {}, run {}", .{ std.fmt.fmtDuration(jitStartupNs), std.fmt.fmtDuration(jitRunNs) });
+    Logger.log.info("Sim starts {d:.2}x faster and runs {d:.2}x slower than the JIT", .{
+        @as(f64, @floatFromInt(jitStartupNs)) / @as(f64, @floatFromInt(@max(sim.startupNs, 1))),
+        @as(f64, @floatFromInt(sim.runNs)) / @as(f64, @floatFromInt(@max(jitRunNs, 1))),
+    });
+}
+
+// Runtime of the generated main, what the -O levels and overflow modes are compared on
+fn benchRun(arguments: Arguments, entry: anytype) void {
+    var timer = std.time.Timer.start() catch unreachable;
+    for (0..Sim.benchRuns) |_| {
+        std.mem.doNotOptimizeAway(entry.call());
+    }
 
+    Logger.log.info("-O{} {s} main runs in {}", .{ arguments.optimize, @tagName(arguments.overflow), std.fmt.fmtDuration(timer.read() / Sim.benchRuns) });
+}
+
+// Calls the placed main as is, run without -tiered
+const Direct = struct {
+    f: *const fn () u8,
+
+    pub fn call(self: @This()) u8 {
+        return self.f();
+    }
+};
+
+fn runTiered(arguments: Arguments, tier: *Tier, sim: ?Sim.Result, jitStartupNs: u64) u8 {
+    const r = runMain(arguments, tier, sim, jitStartupNs);
+    if (arguments.bench) tier.report();
+    return r;
+}
+
+// entry is a Direct or a *Tier
+fn runMain(arguments: Arguments, entry: anytype, sim: ?Sim.Result, jitStartupNs: u64) u8 {
+    if (sim) |r| {
+        compareTiers(r, jitStartupNs, entry);
+        return r.value;
+    }
+    if (arguments.bench) benchRun(arguments, entry);
+    return entry.call();
+}
+
+fn benchParser(units: []const Unit) void {
+    var allocs: u64 = 0;
+    var resizes: u64 = 0;
+    var bytes: u64 = 0;
+    var tokens: usize = 0;
+    for (units) |u| {
+        allocs += u.parseAllocs;
+        resizes += u.parseResizes;
+        bytes += u.parseBytes;
+        if (u.hasLexer) tokens += u.lexer.tokens.len;
+    }
+
+    Logger.log.info("Parser allocations {} ({} resizes, {} bytes) for {} tokens", .{ allocs, resizes, bytes, tokens });
+}
+
+pub fn main() u8 {
     var arena = std.heap.ArenaAllocator.init(std.heap.page_allocator);
     defer arena.deinit();
 
@@ -100,59 +200,107 @@ pub fn main() u8 {
 
     _ = arena.reset(std.heap.ArenaAllocator.ResetMode.retain_capacity);
 
+    if (arguments.client) return Serve.client(alloc, arguments);
+
+    var session: Session = undefined;
+    session.init(arguments.serve) catch {
+        Logger.log.err("Out of memory", .{});
+        return 1;
+    };
+    defer session.deinit();
+
+    if (arguments.serve) return Serve.serve(&arena, &session, arguments.socket, &compile);
+    return compile(alloc, arguments, &session);
+}
+
+// One compile from the sources to whatever the subcommand asked for, its exit
+// code is the process exit code or the one serve sends back
+fn compile(alloc: std.mem.Allocator, arguments: Arguments, session: *Session) u8 {
+    var timer = std.time.Timer.start() catch unreachable;
+    Logger.silence = arguments.silence;
+
     if (arguments.run and arguments.stdout) {
         Logger.log.warn("Subcommand run wont print anything", .{});
     }
 
-    if (arguments.bench)
-        Logger.log.info("Lexing and Parsing", .{});
-    var lexer = lex(alloc, arguments) orelse {
-        usage();
+    const paths = Unit.sources(alloc, arguments.paths) catch |err| {
+        Logger.log.err("Could not collect the source files because {}", .{err});
         return 1;
     };
-    defer lexer.deinit();
+    if (paths.len == 0) {
+        Logger.log.err("No .yt files found", .{});
+        return 1;
+    }
 
-    if (arguments.lex) {
-        const lexContent = lexer.toString(alloc) catch {
-            Logger.log.err("Out of memory", .{});
-            return 1;
-        };
-        defer lexContent.deinit();
+    const units = alloc.alloc(Unit, paths.len) catch {
+        Logger.log.err("Out of memory", .{});
+        return 1;
+    };
+    for (units, paths) |*u, path| u.init(path);
+    defer for (units) |*u| u.deinit();
 
-        const name = getName(lexer.absPath, "lex");
-        writeAll(lexContent.items, arguments, name);
+    if (arguments.bench)
+        Logger.log.info("Lexing and Parsing", .{});
 
-        return 0;
-    }
+    var lexTimer = std.time.Timer.start() catch unreachable;
+    Unit.runAll(units, arguments.mmap, !arguments.lex, arguments.bench, session.pool);
 
-    var parser = Parser.init(alloc, &lexer);
-    defer parser.deinit();
+    if (arguments.bench)
+        benchLexer(units, lexTimer.read());
+
+    // Reported in file order, not in the order the workers finished
     var unexpectedToken = false;
-    parser.parse() catch |err| switch (err) {
-        error.OutOfMemory => {
-            Logger.log.err("Out of memory", .{});
-            return 1;
-        },
-        error.UnexpectedToken => {
-            unexpectedToken = true;
-            for (parser.errors.items) |e| {
-                e.display();
-            }
-        },
-    };
+    for (units) |*u| {
+        switch (u.state) {
+            .couldNotLex => {
+                usage();
+                return 1;
+            },
+            .outOfMemory => {
+                Logger.log.err("Out of memory", .{});
+                return 1;
+            },
+            .unexpectedToken => {
+                unexpectedToken = true;
+                for (u.parser.errors.items) |e| {
+                    e.display();
+                }
+            },
+            .pending, .ok => {},
+        }
+    }
 
-    if (arguments.bench)
+    if (arguments.lex) {
+        for (units) |*u| {
+            const lexContent = u.lexer.toString(alloc) catch {
+                Logger.log.err("Out of memory", .{});
+                return 1;
+            };
+            defer lexContent.deinit();
+
+            const name = getName(u.lexer.absPath, "lex");
+            writeAll(lexContent.items, arguments, name);
+        }
+
+        return 0;
+    }
+
+    if (arguments.bench) {
+        benchParser(units);
         Logger.log.info("Finished in {}", .{std.fmt.fmtDuration(timer.lap())});
+    }
 
     if (arguments.parse) {
-        const cont = parser.toString(alloc) catch {
-            Logger.log.err("Out of memory", .{});
-            return 1;
-        };
-        defer cont.deinit();
-
-        const name = getName(lexer.absPath, "parse");
-        writeAll(cont.items, arguments, name);
+        for (units) |*u| {
+            const cont = u.parser.toString(alloc) catch {
+                Logger.log.err("Out of memory", .{});
+                return 1;
+            };
+            defer cont.deinit();
+
+            const name = getName(u.lexer.absPath, "parse");
+            writeAll(cont.items, arguments, name);
+        }
 
         return 0;
     }
@@ -160,7 +308,13 @@ pub fn main() u8 {
     if (arguments.bench)
         Logger.log.info("Type Checking", .{});
 
-    if (typeCheck(parser.program) catch {
+    const programs = alloc.alloc(*Parser.Program, units.len) catch {
+        Logger.log.err("Out of memory", .{});
+        return 1;
+    };
+    for (programs, units) |*p, *u| p.* = &u.parser.program;
+
+    if (typeCheck(programs) catch {
         Logger.log.err("out of memory", .{});
         return 1;
     }) return 1;
@@ -170,17 +324,43 @@ pub fn main() u8 {
     if (arguments.bench)
         Logger.log.info("Finished in {}", .{std.fmt.fmtDuration(timer.lap())});
 
+    if (arguments.bench)
+        Logger.log.info("Constant Folding", .{});
+
+    var foldStats = ConstantFold.Stats{};
+    for (units) |*u| {
+        ConstantFold.constantFold(alloc, &u.parser.program, arguments.overflow, &foldStats) catch {
+            Logger.log.err("Out of memory", .{});
+            return 1;
+        };
+    }
+
+    if (arguments.bench) {
+        Logger.log.info("Folded {} operators, propagated {} variables, removed {} nodes", .{ foldStats.folded, foldStats.propagated, foldStats.removed });
+        Logger.log.info("Finished in {}", .{std.fmt.fmtDuration(timer.lap())});
+    }
+
     if (arguments.bench)
         Logger.log.info("Intermediate Represetation", .{});
-    var ir = IR.init(&parser.program, alloc);
+    // Only executables are cached, the JIT compiles everything
+    var cache: ?Cache = if (arguments.build and arguments.cache) Cache.init(alloc, arguments) else null;
+    defer if (cache) |*c| c.deinit();
+
+    var ir = IR.init(alloc, if (cache) |*c| c else null);
     defer ir.deinit();
 
-    const m = tb.Module.create(tb.Arch.X86_64, tb.System.LINUX, arguments.run);
+    const m = tb.Module.create(tb.Arch.X86_64, tb.System.LINUX, arguments.run or arguments.simulation);
+    // serve compiles one module per request
+    defer m.destroy();
 
-    ir.toIR(m) catch {
-        Logger.log.err("out of memory", .{});
-        return 1;
-    };
+    var failed = false;
+    for (programs) |p| {
+        if (!(ir.toIR(p, m) catch {
+            Logger.log.err("out of memory", .{});
+            return 1;
+        })) failed = true;
+    }
+    if (failed) return 1;
 
     if (arguments.bench)
         Logger.log.info("Finished in {}", .{std.fmt.fmtDuration(timer.lap())});
@@ -192,62 +372,139 @@ pub fn main() u8 {
         };
         defer cont.deinit();
 
-        const name = getName(lexer.absPath, "ir");
+        const name = getName(units[0].lexer.absPath, "ir");
         writeAll(cont.items, arguments, name);
 
         return 0;
     }
 
+    var simResult: ?Sim.Result = null;
+    if (arguments.simulation) {
+        const simulated = session.execute(Sim.Error!Sim.Result, Sim.simulate, .{ alloc, &ir.ir, arguments.overflow, arguments.bench }) orelse return session.status;
+        const r = simulated catch |err| {
+            switch (err) {
+                error.OutOfMemory => Logger.log.err("Out of memory", .{}),
+                error.UnsupportedFloat => Logger.log.err("sim does not support floats yet, use run", .{}),
+            }
+            return 1;
+        };
+        if (!arguments.bench) return r.value;
+
+        // -b goes on to JIT the same program to compare both tiers
+        Sim.report(r);
+        simResult = r;
+    }
+
     if (arguments.bench)
         Logger.log.info("CodeGen", .{});
 
-    const path = getName(lexer.absPath, "");
+    var jitTimer = std.time.Timer.start() catch unreachable;
+
+    const path = getName(units[0].lexer.absPath, "");
+
+    // Shared by the builder peepholes and tb_opt, codegen workers own theirs
+    const ws = session.ws;
 
-    var a: tb.Arena = undefined;
-    tb.Arena.create(&a, "For main Module");
-    defer a.destroy();
+    const features = March.forArguments(arguments);
+    if (arguments.bench) Logger.log.info("-march={}", .{March.fmt(features)});
 
-    const startF = ir.codeGen(m) catch {
+    // Tier 0 skips tb_opt and counts the calls of every function
+    const tiered = arguments.tiered and arguments.run;
+    var counters: ?[]u64 = null;
+    if (tiered) {
+        counters = alloc.alloc(u64, ir.ir.idens.names.items.len) catch {
+            Logger.log.err("Out of memory", .{});
+            return 1;
+        };
+        @memset(counters.?, 0);
+    }
+    const level = if (tiered) @min(arguments.optimize, 1) else arguments.optimize;
+
+    var optStats = IR.OptStats{};
+    const startF = ir.codeGen(m, ws, level, arguments.overflow, if (arguments.bench) &optStats else null, counters) catch {
         Logger.log.err("Out of memory", .{});
         return 1;
     };
 
-    if (arguments.bench)
+    if (arguments.bench) {
+        Logger.log.info("-O{} built {} functions in {} ({} nodes), optimized in {} ({} nodes)", .{
+            level,
+            optStats.functions,
+            std.fmt.fmtDuration(optStats.buildNs),
+            optStats.nodesBuilt,
+            std.fmt.fmtDuration(optStats.optNs),
+            optStats.nodesOptimized,
+        });
         Logger.log.info("Finished in {}", .{std.fmt.fmtDuration(timer.lap())});
+    }
 
-    if (!arguments.run and arguments.stdout) {
+    if (!arguments.run and !arguments.assembly and arguments.stdout) {
         startF.print();
         var funcsIterator = ir.ir.funcs.valueIterator();
         while (funcsIterator.next()) |func| {
-            func.func.print();
+            if (func.func) |f| f.print();
         }
         return 0;
     }
 
-    {
-        const ws = tb.Worklist.alloc();
-        defer ws.free();
+    const jobs = ir.codeGenJobs(startF) catch {
+        Logger.log.err("Out of memory", .{});
+        return 1;
+    };
+    defer alloc.free(jobs);
 
-        var funcIterator = ir.ir.funcs.valueIterator();
-        {
-            var feature: tb.FeatureSet = undefined;
-            _ = startF.codeGen(ws, &a, &feature, false);
-        }
+    // Every worker emits into its own arena, the session keeps them past the export and the JIT
+    var codeGen = CodeGen.init(jobs, session.workers, session.pool, features, arguments.assembly);
+    codeGen.run();
 
-        while (funcIterator.next()) |func| {
-            var feature: tb.FeatureSet = undefined;
-            _ = func.func.codeGen(ws, &a, &feature, false);
-        }
+    for (jobs) |job| {
+        if (cache) |*c| if (job.cacheKey) |k| c.store(k, job.out.getCode());
+    }
+
+    if (arguments.assembly) {
+        const cont = Asm.toString(alloc, jobs, features, arguments.json) catch {
+            Logger.log.err("Out of memory", .{});
+            return 1;
+        };
+        defer cont.deinit();
+
+        const name = getName(units[0].lexer.absPath, if (arguments.json) "json" else "asm");
+        writeAll(cont.items, arguments, name);
+        if (arguments.bench) codeGen.report();
+
+        return 0;
+    }
+
+    if (arguments.bench) {
+        codeGen.report();
+        if (cache) |c| Logger.log.info("Cache {} hits, {} misses", .{ c.hits, c.misses });
     }
 
     if (arguments.build) {
-        const r = generateExecutable(alloc, m, &a, path);
+        const r = generateExecutable(alloc, m, &session.arena, path, arguments.bench);
         if (r != 0) return r;
     } else {
-        const jit = tb.Jit.begin(m, 1024 ^ 3);
-        const func = jit.placeFunction(ir.ir.funcs.get("main").?.func);
-        const mainf: *fn () u8 = @ptrCast(func.?);
-        return mainf();
+        var jit = Jit.init(alloc, m, arguments.jitHeap);
+        defer jit.deinit();
+
+        const irMain = ir.ir.lookup("main").?;
+        const func = jit.place(.{ .id = irMain.id }, irMain.func.?, codeGen.codeSize(irMain.func.?)) catch {
+            Logger.log.err("Out of memory", .{});
+            return 1;
+        } orelse {
+            Logger.log.err("Could not place main in the JIT heap", .{});
+            return 1;
+        };
+        if (arguments.bench) jit.report();
+
+        const mainf: *const fn () u8 = @ptrCast(func);
+        // Under serve main runs in a child, the tier statistics are reported from there
+        if (!tiered) return session.execute(u8, runMain, .{ arguments, Direct{ .f = mainf }, simResult, jitTimer.read() }) orelse session.status;
+
+        var tier = Tier.init(irMain, m, &jit, arguments.overflow, features, mainf, &counters.?[irMain.id], arguments.tierUp);
+        defer tier.deinit();
+
+        return session.execute(u8, runTiered, .{ arguments, &tier, simResult, jitTimer.read() }) orelse session.status;
     }
 
     return 0;
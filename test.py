@@ -87,13 +87,15 @@ class RunStats:
     ignored: int = 0
     failed_files: List[str] = field(default_factory=list)
 
-def run_test_for_file_stdout(file_path: str, subcommand: str, stats: RunStats = RunStats()):
+# expected names the .bi file to compare with when it is not the subcommand's own,
+# sim is checked against the output of run
+def run_test_for_file_stdout(file_path: str, subcommand: str, stats: RunStats = RunStats(), expected: Optional[str] = None):
     assert path.isfile(file_path)
     assert file_path.endswith(EXT)
 
     print('[INFO] Testing %s, With Subcommand %s' % (file_path, subcommand))
 
-    tc_path = file_path[:-len(EXT)] + '.' + subcommand + ".bi"
+    tc_path = file_path[:-len(EXT)] + '.' + (expected or subcommand) + ".bi"
     tc = load_test_case(tc_path)
 
     error = False
@@ -125,6 +127,46 @@ def run_test_for_file_stdout(file_path: str, subcommand: str, stats: RunStats =
     if error:
         stats.failed_files.append(file_path)
 
+# build links in process with the ELF writer, running what it wrote checks the
+# segments, GOT and relocations against the expectations of run
+def run_build_test_for_file(file_path: str, stats: RunStats = RunStats()):
+    assert path.isfile(file_path)
+    assert file_path.endswith(EXT)
+
+    tc = load_test_case(file_path[:-len(EXT)] + ".run.bi")
+    if tc is None:
+        # run already checked that it builds
+        return
+
+    print('[INFO] Testing %s, With Subcommand build' % file_path)
+
+    exe = "./" + path.basename(file_path)[:-len(EXT)]
+    error = False
+    com = cmd_run_echoed([COMMAND, "build", file_path, "-s", *tc.argv])
+    if com.returncode != 0:
+        print("[ERROR] Could not build %s" % file_path)
+        error = True
+    else:
+        com = cmd_run_echoed([exe], input=tc.stdin, capture_output=True)
+        if com.returncode != tc.returncode or com.stdout != tc.stdout or com.stderr != tc.stderr:
+            print("[ERROR] Unexpected output of the executable")
+            print("  Expected:")
+            print("    return code: %s" % tc.returncode)
+            print("    stdout: \n%s" % tc.stdout.decode("utf-8"))
+            print("    stderr: \n%s" % tc.stderr.decode("utf-8"))
+            print("  Actual:")
+            print("    return code: %s" % com.returncode)
+            print("    stdout: \n%s" % com.stdout.decode("utf-8"))
+            print("    stderr: \n%s" % com.stderr.decode("utf-8"))
+            error = True
+
+    if path.isfile(exe):
+        os.remove(exe)
+
+    if error:
+        stats.failed += 1
+        stats.failed_files.append(file_path)
+
 def run_test_for_file(file_path: str, subcommand: str, stats: RunStats = RunStats()):
     assert path.isfile(file_path)
     assert file_path.endswith(EXT)
@@ -169,6 +211,8 @@ def run_all_test_for_file(file_path: str, stats: RunStats = RunStats()):
    # run_test_for_file_stdout(file_path, 'ir', stats)
    # run_test_for_file_stdout(file_path, 'build', stats)
    run_test_for_file_stdout(file_path, 'run', stats)
+   run_test_for_file_stdout(file_path, 'sim', stats, expected='run')
+   run_build_test_for_file(file_path, stats)
 
 def run_test_for_folder(folder: str):
     stats = RunStats()